@@ -17,6 +17,7 @@
 #include "xcp_cfg.h"
 #include "xcptl_cfg.h"
 #include "xcp.hpp"
+#include "xcpServer.h"
 
 #include "A2L.hpp"
 
@@ -62,6 +63,7 @@ public:
 
     // Task
     std::thread *t;
+    tCyclicTask cyclicTask; // Absolute time activation, jitter and execution time statistics
 
     SigGen(const char* instanceName, uint32_t cycleTimeUs, double ampl, double offset, double phase, double period) : XcpObject(instanceName,"SigGen",sizeof(SigGen)) {
 
@@ -75,7 +77,11 @@ public:
         // Init signals
         value = 0; 
 
+        // Calibration parameters are written directly from the XCP command thread, without waiting for the next cycle of the task
+        xcpRegister();
+
         // Start ECU task thread
+        cyclicTaskInit(&cyclicTask, instanceName, cycleTimeUs, CYCLIC_TASK_SKIP);
         t = new std::thread([this]() { task(); });
     }
          
@@ -97,7 +103,8 @@ public:
         printf("ECU task %s running\n", instanceName);
         for (;;) {
 
-            sleepNs(par_cycleTimeUs * 1000); 
+            cyclicTask.cycleUs = par_cycleTimeUs; // cycletime is a calibration parameter
+            cyclicTaskWait(&cyclicTask);
             value = par_offset + par_ampl * sin( (double)clockGet64() * M_2PI / (CLOCK_TICKS_PER_S * par_period) + par_phase);
             calcMinMax(value); // track the tasks with current minimum and maximum value
 
@@ -108,6 +115,7 @@ public:
     }
 
     ~SigGen() {
+        xcpUnregister(); // Before the members are destroyed
         delete t;
     }
 
@@ -138,6 +146,13 @@ int main(int argc, char* argv[]) {
     // XCP singleton and A2L init (using the A2L factory from Xcp)
     Xcp* xcp = Xcp::getInstance();
     if (!xcp->init(gOptionAddr, gOptionPort, gOptionUseTCP, FALSE)) return -1;
+
+    // Real time scheduling, CPU affinity and memory locking for the XCP server threads
+    if (gOptionRtPriority > 0 || gOptionCpuMask != 0) {
+        tThreadConfig threadConfig = { (uint8_t)(gOptionRtPriority > 0 ? THREAD_SCHED_FIFO : THREAD_SCHED_DEFAULT), gOptionRtPriority, gOptionCpuMask };
+        if (gOptionRtPriority > 0) memoryLock();
+        XcpServerConfigureThreads(XCP_SERVER_THREAD_ALL, &threadConfig);
+    }
     A2L* a2l = xcp->createA2L("CPP_DEMO");
 
     // Create a calibration parameter to control the debug output verbosity
@@ -182,6 +197,9 @@ int main(int argc, char* argv[]) {
         if (_kbhit()) {  if (_getch() == 27) break;  } // Stop on ESC
     }
 
+    // Task timing statistics
+    for (int i = 0; i <= 9; i++) cyclicTaskPrintStatistics(&sigGen[i]->cyclicTask);
+
     // XCP shutdown
     xcp->shutdown();
 
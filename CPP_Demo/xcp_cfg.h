@@ -41,11 +41,26 @@
 /*----------------------------------------------------------------------------*/
 /* Protocol features */
 
+#define XCP_MAX_SERVERS 1 // Max number of independent server instances (XcpServerInitExt)
+
 //#define XCP_ENABLE_INTERLEAVED
 //#define XCP_INTERLEAVED_QUEUE_SIZE 16
 
+//#define XCP_ENABLE_ASYNC_CMD // Enable async execution of long running commands in the server worker thread
+//#define XCP_CMD_QUEUE_SIZE 4 // Max number of pending commands
+
+//#define XCP_ENABLE_BLOCK_MODE // Enable master block DOWNLOAD_NEXT and server block UPLOAD
+//#define XCP_MAX_BS 2 // Max number of packets in a master block
+//#define XCP_MIN_ST 0 // Min separation time of master block packets in 100us
+
+#define XCP_ENABLE_POLL_LIST // Enable USER_CMD polling lists
+#define XCP_MAX_POLL_LISTS 4 // Max number of polling lists
+#define XCP_MAX_POLL_ENTRIES 64 // Max number of entries per polling list
+
 //#define XCP_ENABLE_CHECKSUM // Enable checksum calculation command
+//#define XCP_CHECKSUM_TYPE XCP_CHECKSUM_TYPE_CRC32 // BUILD_CHECKSUM type (default XCP_ADD_44)
 //#define XCP_ENABLE_CAL_PAGE // Enable cal page switch
+//#define XCP_ENABLE_FREEZE_CAL_PAGE // Enable persistent cal pages (SET_SEGMENT_MODE FREEZE and SET_REQUEST STORE_CAL_REQ)
 
 /*----------------------------------------------------------------------------*/
 /* GET_ID command */
@@ -61,9 +76,21 @@
 #define XCP_MAX_EVENT 256 // Maximum number of events, size of event table
 #define XCP_ENABLE_MULTITHREAD_EVENTS // Make XcpEvent thread safe also for same event from different thread
 
-//#define XCP_ENABLE_PACKED_MODE // Enable packed mode emulation
+//#define XCP_ENABLE_PACKED_MODE // Enable packed mode (element grouped, timestamp of last sample)
+
+#define XCP_ENABLE_DAQ_PRESCALER // Enable DAQ list prescaler (SET_DAQ_LIST_MODE prescaler > 1)
+//#define XCP_ENABLE_DAQ_ON_CHANGE // Enable on change events, which send only changed ODTs (XcpSetEventOnChange)
+//#define XCP_ENABLE_DAQ_SEQLOCK // Enable consistent sampling of memory regions protected by sequence counters (XcpCreateSeqLockRegion)
+//#define XCP_ENABLE_DAQ_STIM // Enable stimulation (STIM DAQ lists, applied to application memory when the event fires)
+
+#define XCP_ENABLE_TIMER_EVENTS // Enable server owned cyclic events, triggered by the XCP server timer thread, to measure not instrumented global variables
+#define XCP_TIMER_EVENT_CYCLES_MS { 1, 10, 100 } // Cycle times of the timer events "timer_<n>ms"
 
+//#define XCP_ENABLE_DAQ_ARENA // Enable DAQ memory committed on demand, XCP_DAQ_MEM_SIZE is reserved address space only
 #define XCP_DAQ_MEM_SIZE (5*100) // Amount of memory for DAQ tables, each ODT entry (e.g. measurement variable) needs 5 bytes
+//#define XCP_DAQ_HDR_TYPE DAQ_HDR_ODT_FIL_DAQW // DTO identification field type, DAQ_HDR_PID (1 byte absolute ODT number, max 128 ODTs), DAQ_HDR_ODT_DAQB (default, max 255 DAQ lists), DAQ_HDR_ODT_DAQW or DAQ_HDR_ODT_FIL_DAQW (max 65535 DAQ lists)
+//#define XCP_ENABLE_DAQ_NO_TIMESTAMP // Enable DAQ lists without timestamp, which rely on the timestamp of another DAQ list of the same event
+//#define XCP_ENABLE_DAQ_RESUME // Enable persistent DAQ configuration (SET_REQUEST STORE_DAQ_REQ) and resume mode, DAQ lists in resume mode are started on CONNECT after restart
 
 // DAQ clock info
 #ifndef CLOCK_USE_UTC_TIME_NS
@@ -64,3 +64,9 @@ Drawbacks:
     #define XCPTL_MULTICAST_PORT 5557
 #endif
 
+// Single threaded server
+// Command receive, multicast receive and transmit in one epoll event loop thread, instead of a receive, transmit and multicast thread (Linux only)
+#ifdef _LINUX
+//#define XCPTL_ENABLE_EPOLL
+#endif
+
@@ -15,6 +15,9 @@
 #include "platform.h"
 #include "xcpLite.h"
 #include "A2L.h"
+#if OPTION_ENABLE_CAL_SEGMENT
+#include "calSeg.h"
+#endif
 #include "ecu.h"
 
 
@@ -24,6 +27,12 @@
 
 // Event
 uint16_t gXcpEvent_EcuCyclic = 0; // XCP event number
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+uint16_t gXcpEvent_EcuOnChange = 0; // XCP event number for slowly changing signals
+#endif
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+tXcpSeqLock gChannelLock = 0; // Sequence counter to measure channel1..3 consistent
+#endif
 
 // Global measurement variables
 double ecuTime = 0;
@@ -76,10 +85,15 @@ struct ecuPar ecuPar = {
     { 0,1,3,6,9,15,20,30,38,42,44,46,48,50,48,45,40,33,25,15,5,4,3,2,1,0,0,1,4,8,4,0} // curve1_32
 };
 
-volatile struct ecuPar* ecuCalPage = &ecuPar;
-
+// Access to the parameters from the ECU task
+// With calibration segments, the task locks a consistent page for one cycle
 #if OPTION_ENABLE_CAL_SEGMENT
-volatile struct ecuPar ecuRamPar;
+static tCalSegIndex ecuParSeg = CAL_SEG_INVALID;
+#define ecuParLock() ((const struct ecuPar*)calSegLock(ecuParSeg))
+#define ecuParUnlock(p) calSegUnlock(ecuParSeg, p)
+#else
+#define ecuParLock() (&ecuPar)
+#define ecuParUnlock(p)
 #endif
 
 /**************************************************************************/
@@ -90,49 +104,13 @@ char* ecuGetEPK() {
     return (char*)ecuPar.epk;
 }
 
-#if OPTION_ENABLE_CAL_SEGMENT
-
-// Calibration page handling
-// page 0 is RAM, page 1 is ROM
-#define RAM 0
-#define ROM 1
-// A2L file contains ROM addresses
-
-void ecuParInit() {
-
-    memcpy((void*)&ecuRamPar, (void*)&ecuPar, sizeof(struct ecuPar));
-    ecuParSetCalPage(0);
-}
-
-void ecuParSetCalPage(uint8_t page) {
-
-    ecuCalPage = (page == RAM) ? &ecuRamPar : (struct ecuPar *)&ecuPar;
-}
-
-uint8_t ecuParGetCalPage() {
-
-    return (ecuCalPage == &ecuRamPar) ? RAM : ROM;
-}
-
-uint8_t *ecuParAddrMapping( uint8_t *a ) {
-
-    if (a >= (uint8_t*)&ecuPar && a < (uint8_t*)&ecuPar + sizeof(struct ecuPar)) {
-      if (ecuCalPage == &ecuPar) return a; // RAM
-      assert(ecuCalPage == &ecuRamPar);
-      return (uint8_t*)&ecuRamPar + (a - (uint8_t*)&ecuPar); // ROM -> RAM
-    }
-    return a;
-}
-
-#endif // OPTION_ENABLE_CAL_SEGMENT
-
 // Init demo parameters and measurements 
 void ecuInit() {
 
     // Initialize calibration parameters
 #if OPTION_ENABLE_CAL_SEGMENT
-    ecuParInit(); // Initializes parameters in RAM calibration segment
-    ecuParSetCalPage(0); // Switch to RAM calibration segment 
+    // Calibration segment with RAM pages initialized from ecuPar, A2L addresses refer to ecuPar
+    ecuParSeg = calSegCreate("ecuPar", &ecuPar, sizeof(ecuPar));
 #endif
 
     // Initialize measurement variables
@@ -148,6 +126,19 @@ void ecuInit() {
 
     // Create an XCP event for the cyclic task
     gXcpEvent_EcuCyclic = XcpCreateEvent("ecuTask", 2*CLOCK_TICKS_PER_MS, 0, 0, 0);
+
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+    // Create an XCP event in the cyclic task, which sends only changed data, at least once per second
+    gXcpEvent_EcuOnChange = XcpCreateEvent("ecuOnChange", 2*CLOCK_TICKS_PER_MS, 0, 0, 0);
+    XcpSetEventOnChange(gXcpEvent_EcuOnChange, 500);
+#endif
+
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+    // Sample channel1..3 consistent, when measured from other threads
+    XcpCreateSeqLockRegion(&gChannelLock, (uint8_t*)&channel1, sizeof(channel1));
+    XcpCreateSeqLockRegion(&gChannelLock, (uint8_t*)&channel2, sizeof(channel2));
+    XcpCreateSeqLockRegion(&gChannelLock, (uint8_t*)&channel3, sizeof(channel3));
+#endif
 }
 
 
@@ -156,7 +147,7 @@ void ecuCreateA2lDescription() {
 
     // Calibration Memory Segment
 #if OPTION_ENABLE_CAL_SEGMENT  
-    A2lCreate_MOD_PAR(ApplXcpGetAddr((uint8_t*)&ecuPar), sizeof(ecuPar), (char*)ecuPar.epk);
+    A2lCreate_MOD_PAR((char*)ecuPar.epk);
 #endif
 
     // Parameters
@@ -195,7 +186,7 @@ void ecuCreateA2lDescription() {
 
 
 // Cyclic demo task 
-void ecuCyclic( void )
+void ecuCyclic(const struct ecuPar* par)
 {
     // Counters of different type
     sbyteCounter++;
@@ -211,16 +202,32 @@ void ecuCyclic( void )
     byteArray1[i] ++;
 
     // Floating point signals
-    double x = M_2PI * ecuTime / ecuCalPage->period;
-    channel1 = ecuCalPage->offset + ecuCalPage->ampl * sin(x);
-    channel2 = ecuCalPage->offset + ecuCalPage->ampl * sin(x + M_PI * 1 / 3);
-    channel3 = ecuCalPage->offset + ecuCalPage->ampl * sin(x + M_PI * 2 / 3);
+    double x = M_2PI * ecuTime / par->period;
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+    XcpSeqLockWriteBegin(&gChannelLock);
+#endif
+    channel1 = par->offset + par->ampl * sin(x);
+    channel2 = par->offset + par->ampl * sin(x + M_PI * 1 / 3);
+    channel3 = par->offset + par->ampl * sin(x + M_PI * 2 / 3);
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+    XcpSeqLockWriteEnd(&gChannelLock);
+#endif
     ecuTime += 0.002;
 
     XcpEvent(gXcpEvent_EcuCyclic); // Trigger XCP measurement data aquisition event 
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+    XcpEvent(gXcpEvent_EcuOnChange);
+#endif
 }
 
 
+static tCyclicTask ecuCyclicTask;
+
+// Print the activation jitter and execution time statistics of the ECU task
+void ecuPrintStatistics() {
+    cyclicTaskPrintStatistics(&ecuCyclicTask);
+}
+
 // ECU cyclic (2ms default) demo task
 #ifdef _WIN
 DWORD WINAPI ecuTask(LPVOID p)
@@ -228,10 +235,16 @@ DWORD WINAPI ecuTask(LPVOID p)
 void* ecuTask(void* p)
 #endif
 {
+    const struct ecuPar* par;
+
     (void)p;
-    printf("Start C task (cycle = %dus, XCP event = %d)\n", ecuCalPage->cycleTimeUs, gXcpEvent_EcuCyclic);
+    printf("Start C task (cycle = %dus, XCP event = %d)\n", ecuPar.cycleTimeUs, gXcpEvent_EcuCyclic);
+    cyclicTaskInit(&ecuCyclicTask, "ecuTask", ecuPar.cycleTimeUs, CYCLIC_TASK_SKIP);
     for (;;) {
-        sleepNs(ecuCalPage->cycleTimeUs * 1000); // cycletime is a calibration parameter
-        ecuCyclic();
+        cyclicTaskWait(&ecuCyclicTask);
+        par = ecuParLock();
+        ecuCyclicTask.cycleUs = par->cycleTimeUs; // cycletime is a calibration parameter
+        ecuCyclic(par);
+        ecuParUnlock(par); // Quiescent point, parameters are not accessed while sleeping
     }
 }
@@ -20,6 +20,9 @@
 #if OPTION_ENABLE_A2L_GEN
 #include "A2L.h"
 #endif
+#if OPTION_ENABLE_CAL_SEGMENT
+#include "calSeg.h"
+#endif
 #include "ecu.h" // Demo measurement task in C
 
  
@@ -55,6 +58,23 @@ int main(int argc, char* argv[]) {
 
     // Initialize the XCP Server
     if (!XcpServerInit(gOptionAddr, gOptionPort, gOptionUseTCP)) return 0;
+#if XCP_MAX_SERVERS > 1
+    // Second independent XCP server on the next port, for a second tool
+    // It has its own DAQ setup and server timer events, the events of the ECU task belong to the first server
+    if (!XcpServerInitExt(1, gOptionAddr, (uint16_t)(gOptionPort + 1), gOptionUseTCP)) return 0;
+#endif
+
+    // Real time scheduling, CPU affinity and memory locking for the XCP server threads
+    if (gOptionRtPriority > 0 || gOptionCpuMask != 0) {
+        tThreadConfig threadConfig = { (uint8_t)(gOptionRtPriority > 0 ? THREAD_SCHED_FIFO : THREAD_SCHED_DEFAULT), gOptionRtPriority, gOptionCpuMask };
+        if (gOptionRtPriority > 0) memoryLock();
+        XcpServerConfigureThreads(XCP_SERVER_THREAD_ALL, &threadConfig);
+    }
+
+#if OPTION_ENABLE_CAL_SEGMENT && defined(OPTION_CAL_SEGMENT_FILE_NAME)
+    // Map the persistent calibration pages, the calibration segments are initialized with the last frozen values
+    calSegOpenFile(OPTION_CAL_SEGMENT_FILE_NAME, ecuGetEPK());
+#endif
 
     // Initialize measurement task thread
     ecuInit();
@@ -68,6 +88,9 @@ int main(int argc, char* argv[]) {
     for (;;) {
         sleepMs(100);
         if (!XcpServerStatus()) { printf("\nXCP Server failed\n");  break;  } // Check if the XCP server is running
+#if XCP_MAX_SERVERS > 1
+        if (!XcpServerStatusExt(1)) { printf("\nSecond XCP Server failed\n");  break;  }
+#endif
         if (_kbhit()) {
             if (_getch() == 27) { XcpSendEvent(EVC_SESSION_TERMINATED, NULL, 0);  break; } // Stop on ESC
         }
@@ -77,8 +100,15 @@ int main(int argc, char* argv[]) {
     sleepMs(1000); // give everything a chance to be up and running
     printf("\nPress ESC to stop\n");
     cancel_thread(t2);
+    ecuPrintStatistics();
     
+#if XCP_MAX_SERVERS > 1
+    XcpServerShutdownExt(1);
+#endif
     XcpServerShutdown();
+#if OPTION_ENABLE_CAL_SEGMENT && defined(OPTION_CAL_SEGMENT_FILE_NAME)
+    calSegCloseFile();
+#endif
     socketCleanup();
 
     printf("\nApplication terminated. Press any key to close\n");
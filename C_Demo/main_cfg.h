@@ -34,6 +34,7 @@
 
 // Calibration segment
 #define OPTION_ENABLE_CAL_SEGMENT ON
+#define OPTION_CAL_SEGMENT_FILE_NAME APP_NAME ".cal" // Persistent calibration pages (memory mapped file), RAM pages start with the default values if not defined
 
 #ifdef _WIN
 #define OPTION_ENABLE_XLAPI_V3 OFF 
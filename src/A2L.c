@@ -18,6 +18,9 @@
 #include "xcpLite.h"
 #include "A2L.h"
 
+#define A2L_STR_(x) #x
+#define A2L_STR(x) A2L_STR_(x) // Stringify a numeric config macro
+
 static FILE* gA2lFile = NULL;
 static int gA2lEvent = 0;
 
@@ -50,12 +53,12 @@ static const char* gA2lHeader =
 
 //----------------------------------------------------------------------------------
 #if OPTION_ENABLE_CAL_SEGMENT
-static const char* gA2lMemorySegment =
+static const char* gA2lMemorySegment = // Parameters %s name, %08X start, %08X size, %u segment number
 "/begin MEMORY_SEGMENT\n"
-"CALRAM \"\" DATA FLASH INTERN 0x%08X 0x%08X - 1 - 1 - 1 - 1 - 1\n" // CALRAM_START, CALRAM_SIZE
+"%s \"\" DATA FLASH INTERN 0x%08X 0x%08X - 1 - 1 - 1 - 1 - 1\n"
 "/begin IF_DATA XCP\n"
-"/begin SEGMENT 0x01 0x02 0x00 0x00 0x00 \n"
-"/begin CHECKSUM XCP_ADD_44 MAX_BLOCK_SIZE 0xFFFF EXTERNAL_FUNCTION \"\" /end CHECKSUM\n"
+"/begin SEGMENT %u 0x02 0x00 0x00 0x00 \n"
+"/begin CHECKSUM " XCP_CHECKSUM_A2L " MAX_BLOCK_SIZE 0xFFFFFFFF EXTERNAL_FUNCTION \"\" /end CHECKSUM\n"
 "/begin PAGE 0x01 ECU_ACCESS_WITH_XCP_ONLY XCP_READ_ACCESS_WITH_ECU_ONLY XCP_WRITE_ACCESS_NOT_ALLOWED /end PAGE\n"
 "/begin PAGE 0x00 ECU_ACCESS_WITH_XCP_ONLY XCP_READ_ACCESS_WITH_ECU_ONLY XCP_WRITE_ACCESS_WITH_ECU_ONLY /end PAGE\n"
 "/end SEGMENT\n"
@@ -78,22 +81,32 @@ static const char* gA2lIfData1 = // Parameters %04X version, %u max cto, %u max
 "OPTIONAL_CMD UPLOAD\n"
 "OPTIONAL_CMD SHORT_UPLOAD\n"
 "OPTIONAL_CMD DOWNLOAD\n"
+#ifdef XCP_ENABLE_BLOCK_MODE
+"OPTIONAL_CMD DOWNLOAD_NEXT\n"
+#endif
 "OPTIONAL_CMD SHORT_DOWNLOAD\n"
+#if defined(XCP_ENABLE_DAQ_RESUME) || defined(XCP_ENABLE_FREEZE_CAL_PAGE)
+"OPTIONAL_CMD SET_REQUEST\n"
+#endif
 #ifdef XCP_ENABLE_CAL_PAGE
 "OPTIONAL_CMD GET_CAL_PAGE\n"
 "OPTIONAL_CMD SET_CAL_PAGE\n"
-//"OPTIONAL_CMD CC_GET_PAG_PROCESSOR_INFO\n"    
-//"OPTIONAL_CMD CC_GET_SEGMENT_INFO\n"          
-//"OPTIONAL_CMD CC_GET_PAGE_INFO\n"             
-//"OPTIONAL_CMD CC_SET_SEGMENT_MODE\n"          
-//"OPTIONAL_CMD CC_GET_SEGMENT_MODE\n"          
-//"OPTIONAL_CMD CC_COPY_CAL_PAGE\n"             
+"OPTIONAL_CMD GET_PAG_PROCESSOR_INFO\n"
+"OPTIONAL_CMD GET_SEGMENT_INFO\n"
+"OPTIONAL_CMD GET_PAGE_INFO\n"
+#ifdef XCP_ENABLE_FREEZE_CAL_PAGE
+"OPTIONAL_CMD SET_SEGMENT_MODE\n"
+"OPTIONAL_CMD GET_SEGMENT_MODE\n"
+#endif
+"OPTIONAL_CMD COPY_CAL_PAGE\n"
 #endif
 #ifdef XCP_ENABLE_CHECKSUM
 "OPTIONAL_CMD BUILD_CHECKSUM\n"
 #endif
 //"OPTIONAL_CMD TRANSPORT_LAYER_CMD\n"
-//"OPTIONAL_CMD USER_CMD\n"
+#if defined(XCP_ENABLE_CAL_PAGE) || defined(XCP_ENABLE_POLL_LIST)
+"OPTIONAL_CMD USER_CMD\n"
+#endif
 "OPTIONAL_CMD GET_DAQ_RESOLUTION_INFO\n"
 "OPTIONAL_CMD GET_DAQ_PROCESSOR_INFO\n"
 #ifdef XCP_ENABLE_DAQ_EVENT_INFO
@@ -129,6 +142,9 @@ static const char* gA2lIfData1 = // Parameters %04X version, %u max cto, %u max
 //"OPTIONAL_LEVEL1_CMD SW_DBG_COMMAND_SPACE\n"
 //"OPTIONAL_LEVEL1_CMD POD_COMMAND_SPACE\n"
 #endif
+#ifdef XCP_ENABLE_BLOCK_MODE
+"COMMUNICATION_MODE_SUPPORTED BLOCK SLAVE MASTER " A2L_STR(XCP_MAX_BS) " " A2L_STR(XCP_MIN_ST) "\n"
+#endif
 "/end PROTOCOL_LAYER\n"
 
 //----------------------------------------------------------------------------------
@@ -141,9 +157,23 @@ static const char* gA2lIfData1 = // Parameters %04X version, %u max cto, %u max
 
 //----------------------------------------------------------------------------------
 "/begin DAQ\n" // DAQ
-"DYNAMIC 0 %u 0 OPTIMISATION_TYPE_DEFAULT ADDRESS_EXTENSION_FREE IDENTIFICATION_FIELD_TYPE_RELATIVE_BYTE GRANULARITY_ODT_ENTRY_SIZE_DAQ_BYTE 0xF8 OVERLOAD_INDICATION_PID\n"
+"DYNAMIC 0 %u 0 OPTIMISATION_TYPE_DEFAULT ADDRESS_EXTENSION_FREE " XCP_DAQ_HDR_A2L " GRANULARITY_ODT_ENTRY_SIZE_DAQ_BYTE 0xF8 OVERLOAD_INDICATION_PID\n"
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+"PRESCALER_SUPPORTED\n"
+#endif
+#ifdef XCP_ENABLE_DAQ_RESUME
+"RESUME_SUPPORTED\n"
+"STORE_DAQ_SUPPORTED\n"
+#endif
+#ifdef XCP_ENABLE_DAQ_STIM
+"/begin STIM GRANULARITY_ODT_ENTRY_SIZE_STIM_BYTE 0xF8 /end STIM\n"
+#endif
 "/begin TIMESTAMP_SUPPORTED\n"
+#ifdef XCP_ENABLE_DAQ_NO_TIMESTAMP
+"0x01 SIZE_DWORD %s\n"
+#else
 "0x01 SIZE_DWORD %s TIMESTAMP_FIXED\n"
+#endif
 "/end TIMESTAMP_SUPPORTED\n"; // ... Event list follows
 
 static const char* gA2lIfData2 = // Parameter %s TCP or UDP, %04X tl version, %u port, %s ip address string, %s TCP or UDP
@@ -247,11 +277,19 @@ BOOL A2lOpen(const char *filename, const char* projectName ) {
 
 // Memory segments
 #if OPTION_ENABLE_CAL_SEGMENT
-void A2lCreate_MOD_PAR(uint32_t startAddr, uint32_t size, char *epk) {
+// One MEMORY_SEGMENT for each calibration segment, the segment number is the XCP segment number
+void A2lCreate_MOD_PAR(char *epk) {
 	fprintf(gA2lFile, "/begin MOD_PAR \"\"\n");
 	fprintf(gA2lFile, "EPK \"%s\"\n", epk);
 	fprintf(gA2lFile, "ADDR_EPK 0x%08X\n", ApplXcpGetAddr((uint8_t*)epk));
-	fprintf(gA2lFile, gA2lMemorySegment, startAddr, size);
+#ifdef XCP_ENABLE_CAL_PAGE
+	uint8_t n = ApplXcpGetSegmentCount();
+	for (uint8_t i = 0; i < n; i++) {
+		const char* name;
+		uint32_t addr, size;
+		if (ApplXcpGetSegmentInfo(i, &name, &addr, &size)) fprintf(gA2lFile, gA2lMemorySegment, name, addr, size, i);
+	}
+#endif
 	fprintf(gA2lFile, "/end MOD_PAR\n\n");
 }
 #endif
@@ -272,6 +310,12 @@ void A2lCreate_IF_DATA(BOOL tcp, const uint8_t *addr, uint16_t port) {
   #error
 #endif
 
+#ifdef XCP_ENABLE_DAQ_STIM
+  #define A2L_EVENT_DIRECTION "DAQ_STIM"
+#else
+  #define A2L_EVENT_DIRECTION "DAQ"
+#endif
+
   // Event list in A2L file (if event info by XCP is not active)
 #if defined( XCP_ENABLE_DAQ_EVENT_LIST ) && !defined( XCP_ENABLE_DAQ_EVENT_INFO )
   eventList = XcpGetEventList(&eventCount);
@@ -286,11 +330,16 @@ void A2lCreate_IF_DATA(BOOL tcp, const uint8_t *addr, uint16_t port) {
 	  strncpy(shortName, eventList[i].name, 8);
 	  shortName[8] = 0;
 
-	  fprintf(gA2lFile, "/begin EVENT \"%s\" \"%s\" 0x%X DAQ 0xFF %u %u %u CONSISTENCY DAQ", eventList[i].name, shortName, i, eventList[i].timeCycle, eventList[i].timeUnit, eventList[i].priority);
+	  fprintf(gA2lFile, "/begin EVENT \"%s\" \"%s\" 0x%X %s 0xFF %u %u %u CONSISTENCY DAQ", eventList[i].name, shortName, i, A2L_EVENT_DIRECTION, eventList[i].timeCycle, eventList[i].timeUnit, eventList[i].priority);
 #ifdef XCP_ENABLE_PACKED_MODE
 	  if (eventList[i].sampleCount!=0) {
 		  fprintf(gA2lFile, " /begin DAQ_PACKED_MODE ELEMENT_GROUPED STS_LAST MANDATORY %u /end DAQ_PACKED_MODE",eventList[i].sampleCount);
 	  }
+#endif
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+	  if (eventList[i].keepAlive != 0) { // No AML keyword available, describe on change mode in a comment
+		  fprintf(gA2lFile, " /* ON_CHANGE KEEP_ALIVE %u */", eventList[i].keepAlive);
+	  }
 #endif
 	  fprintf(gA2lFile, " /end EVENT\n");
   }
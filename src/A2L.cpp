@@ -19,9 +19,12 @@
 using namespace std;
 
 #include "xcp.hpp"
+#include "xcpLite.h"
 #define A2L_GET_ADDR
 #include "A2L.hpp"
 
+#define A2L_STR_(x) #x
+#define A2L_STR(x) A2L_STR_(x) // Stringify a numeric config macro
 
 static const char* sHeader =
 "ASAP2_VERSION 1 71\n"
@@ -53,7 +56,7 @@ static const char* sModPar =
 "CALRAM \"\" DATA FLASH INTERN 0x%08X 0x%08X - 1 - 1 - 1 - 1 - 1\n" // CALRAM_START, CALRAM_SIZE
 "/begin IF_DATA XCP\n"
 "/begin SEGMENT 0x01 0x02 0x00 0x00 0x00 \n"
-"/begin CHECKSUM XCP_ADD_44 MAX_BLOCK_SIZE 0xFFFF EXTERNAL_FUNCTION \"\" /end CHECKSUM\n"
+"/begin CHECKSUM " XCP_CHECKSUM_A2L " MAX_BLOCK_SIZE 0xFFFFFFFF EXTERNAL_FUNCTION \"\" /end CHECKSUM\n"
 "/begin PAGE 0x01 ECU_ACCESS_WITH_XCP_ONLY XCP_READ_ACCESS_WITH_ECU_ONLY XCP_WRITE_ACCESS_NOT_ALLOWED /end PAGE\n"
 "/begin PAGE 0x00 ECU_ACCESS_WITH_XCP_ONLY XCP_READ_ACCESS_WITH_ECU_ONLY XCP_WRITE_ACCESS_WITH_ECU_ONLY /end PAGE\n"
 "/end SEGMENT\n"
@@ -78,22 +81,32 @@ static const char* sModPar =
 "OPTIONAL_CMD UPLOAD\n"
 "OPTIONAL_CMD SHORT_UPLOAD\n"
 "OPTIONAL_CMD DOWNLOAD\n"
+#ifdef XCP_ENABLE_BLOCK_MODE
+"OPTIONAL_CMD DOWNLOAD_NEXT\n"
+#endif
 "OPTIONAL_CMD SHORT_DOWNLOAD\n"
+#if defined(XCP_ENABLE_DAQ_RESUME) || defined(XCP_ENABLE_FREEZE_CAL_PAGE)
+"OPTIONAL_CMD SET_REQUEST\n"
+#endif
 #ifdef XCP_ENABLE_CAL_PAGE
 "OPTIONAL_CMD GET_CAL_PAGE\n"
 "OPTIONAL_CMD SET_CAL_PAGE\n"
-//"OPTIONAL_CMD CC_GET_PAG_PROCESSOR_INFO\n"    
-//"OPTIONAL_CMD CC_GET_SEGMENT_INFO\n"          
-//"OPTIONAL_CMD CC_GET_PAGE_INFO\n"             
-//"OPTIONAL_CMD CC_SET_SEGMENT_MODE\n"          
-//"OPTIONAL_CMD CC_GET_SEGMENT_MODE\n"          
-//"OPTIONAL_CMD CC_COPY_CAL_PAGE\n"             
+"OPTIONAL_CMD GET_PAG_PROCESSOR_INFO\n"
+"OPTIONAL_CMD GET_SEGMENT_INFO\n"
+"OPTIONAL_CMD GET_PAGE_INFO\n"
+#ifdef XCP_ENABLE_FREEZE_CAL_PAGE
+"OPTIONAL_CMD SET_SEGMENT_MODE\n"
+"OPTIONAL_CMD GET_SEGMENT_MODE\n"
+#endif
+"OPTIONAL_CMD COPY_CAL_PAGE\n"
 #endif
 #ifdef XCP_ENABLE_CHECKSUM
 "OPTIONAL_CMD BUILD_CHECKSUM\n"
 #endif
 //"OPTIONAL_CMD TRANSPORT_LAYER_CMD\n"
-//"OPTIONAL_CMD USER_CMD\n"
+#if defined(XCP_ENABLE_CAL_PAGE) || defined(XCP_ENABLE_POLL_LIST)
+"OPTIONAL_CMD USER_CMD\n"
+#endif
 "OPTIONAL_CMD GET_DAQ_RESOLUTION_INFO\n"
 "OPTIONAL_CMD GET_DAQ_PROCESSOR_INFO\n"
 #ifdef XCP_ENABLE_DAQ_EVENT_INFO
@@ -129,6 +142,9 @@ static const char* sModPar =
 //"OPTIONAL_LEVEL1_CMD SW_DBG_COMMAND_SPACE\n"
 //"OPTIONAL_LEVEL1_CMD POD_COMMAND_SPACE\n"
 #endif
+#ifdef XCP_ENABLE_BLOCK_MODE
+"COMMUNICATION_MODE_SUPPORTED BLOCK SLAVE MASTER " A2L_STR(XCP_MAX_BS) " " A2L_STR(XCP_MIN_ST) "\n"
+#endif
 "/end PROTOCOL_LAYER\n"
 
 //----------------------------------------------------------------------------------
@@ -141,9 +157,23 @@ static const char* sModPar =
 
 //----------------------------------------------------------------------------------
 "/begin DAQ\n" // DAQ
-"DYNAMIC 0 %u 0 OPTIMISATION_TYPE_DEFAULT ADDRESS_EXTENSION_FREE IDENTIFICATION_FIELD_TYPE_RELATIVE_BYTE GRANULARITY_ODT_ENTRY_SIZE_DAQ_BYTE 0xF8 OVERLOAD_INDICATION_PID\n"
+"DYNAMIC 0 %u 0 OPTIMISATION_TYPE_DEFAULT ADDRESS_EXTENSION_FREE " XCP_DAQ_HDR_A2L " GRANULARITY_ODT_ENTRY_SIZE_DAQ_BYTE 0xF8 OVERLOAD_INDICATION_PID\n"
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+"PRESCALER_SUPPORTED\n"
+#endif
+#ifdef XCP_ENABLE_DAQ_RESUME
+"RESUME_SUPPORTED\n"
+"STORE_DAQ_SUPPORTED\n"
+#endif
+#ifdef XCP_ENABLE_DAQ_STIM
+"/begin STIM GRANULARITY_ODT_ENTRY_SIZE_STIM_BYTE 0xF8 /end STIM\n"
+#endif
 "/begin TIMESTAMP_SUPPORTED\n"
+#ifdef XCP_ENABLE_DAQ_NO_TIMESTAMP
+"0x01 SIZE_DWORD %s\n"
+#else
 "0x01 SIZE_DWORD %s TIMESTAMP_FIXED\n"
+#endif
 "/end TIMESTAMP_SUPPORTED\n"; // ... Event list follows
 
  static const char* sIfData2 = // Parameter %s TCP or UDP, %04X tl version, %u port, %s ip address string, %s TCP or UDP
@@ -311,6 +341,12 @@ void A2L::create_XCP_IF_DATA(BOOL tcp, const uint8_t* addr, uint16_t port) {
 #define XCP_TIMESTAMP_UNIT_S "UNIT_1US"
 #else
 #error
+#endif
+
+#ifdef XCP_ENABLE_DAQ_STIM
+#define A2L_EVENT_DIRECTION "DAQ_STIM"
+#else
+#define A2L_EVENT_DIRECTION "DAQ"
 #endif
 
 	// Event list in A2L file (if event info by XCP is not active)
@@ -323,10 +359,10 @@ void A2L::create_XCP_IF_DATA(BOOL tcp, const uint8_t* addr, uint16_t port) {
 		strncpy(shortName, e.name, 8);
 		shortName[8] = 0;
 
-		fprintf(file, "/begin EVENT \"%s\" \"%s\" 0x%X DAQ 0xFF %u %u %u CONSISTENCY DAQ", e.name, shortName, i, e.timeCycle, e.timeUnit, e.priority);
+		fprintf(file, "/begin EVENT \"%s\" \"%s\" 0x%X %s 0xFF %u %u %u CONSISTENCY DAQ", e.name, shortName, i, A2L_EVENT_DIRECTION, e.timeCycle, e.timeUnit, e.priority);
 #ifdef XCP_ENABLE_PACKED_MODE
-		if (eventList[i].sampleCount != 0) {
-			fprintf(file, " /begin DAQ_PACKED_MODE ELEMENT_GROUPED STS_LAST MANDATORY %u /end DAQ_PACKED_MODE", eventList[i].sampleCount);
+		if (e.sampleCount != 0) {
+			fprintf(file, " /begin DAQ_PACKED_MODE ELEMENT_GROUPED STS_LAST MANDATORY %u /end DAQ_PACKED_MODE", e.sampleCount);
 		}
 #endif
 		fprintf(file, " /end EVENT\n");
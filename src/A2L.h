@@ -75,7 +75,7 @@ extern BOOL A2lOpen(const char *filename, const char* projectName);
 
 // Create memory segments
 #if OPTION_ENABLE_CAL_SEGMENT
-extern void A2lCreate_MOD_PAR( uint32_t startAddr, uint32_t size, char* epk);
+extern void A2lCreate_MOD_PAR(char* epk); // EPK and memory segments of all calibration segments
 #endif
 
 // Create XCP IF_DATA
@@ -0,0 +1,312 @@
+/*----------------------------------------------------------------------------
+| File:
+|   calSeg.c
+|
+| Description:
+|   Calibration segments with double buffered RAM pages and atomic publish
+|
+|   Code released into public domain, no attribution required
+ ----------------------------------------------------------------------------*/
+
+#include "main.h"
+#include "main_cfg.h"
+#include "platform.h"
+#include "util.h"
+#include "calSeg.h"
+
+
+typedef struct {
+    const char* name;
+    uint8_t* default_page;              // Reference page (ROM)
+    uint32_t size;
+    uint8_t* ram_page[2];               // Active page ram_page[active], working page ram_page[active^1]
+    volatile uint32_t active;
+    volatile uint32_t readers[2];       // Number of readers holding ram_page[i]
+    BOOL pending;                       // The working page is still held by a reader and not yet updated from the active page
+    uint8_t ecu_page;                   // Page selected for the application (CAL_SEG_PAGE_RAM or CAL_SEG_PAGE_ROM)
+    uint8_t xcp_page;                   // Page selected for XCP access
+    BOOL freeze;                        // Store the segment on freeze
+    uint8_t* file_page;                 // Persistent page in the memory mapped file or NULL
+} tCalSeg;
+
+static tCalSeg gCalSeg[CAL_SEG_MAX];
+static tCalSegIndex gCalSegCount = 0;
+static tCalSegIndex gCalSegSorted[CAL_SEG_MAX]; // Segment indices sorted by default page address, for address mapping
+
+
+// Persistent calibration pages file
+// Header followed by one record for each segment in the order of creation, each record is followed by the page, 8 byte aligned
+
+#define CAL_SEG_FILE_MAGIC 0x4C414358UL // "XCAL"
+#define CAL_SEG_FILE_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    char epk[CAL_SEG_EPK_SIZE];
+} tCalSegFileHeader;
+
+typedef struct {
+    uint32_t size;
+    char name[28];
+} tCalSegFileRecord;
+
+#define CAL_SEG_FILE_ALIGN(n) (((n) + 7) & ~7UL)
+
+static uint8_t* gCalSegFile = NULL;
+static uint32_t gCalSegFileOffset = 0; // Offset of the next record
+static BOOL gCalSegFileValid = FALSE; // Records up to gCalSegFileOffset match the created segments
+
+BOOL calSegOpenFile(const char* filename, const char* epk) {
+
+    assert(gCalSegFile == NULL && gCalSegCount == 0);
+    gCalSegFile = memoryMapFile(filename, CAL_SEG_FILE_SIZE);
+    if (gCalSegFile == NULL) return FALSE;
+    tCalSegFileHeader* h = (tCalSegFileHeader*)gCalSegFile;
+    gCalSegFileValid = h->magic == CAL_SEG_FILE_MAGIC && h->version == CAL_SEG_FILE_VERSION && strncmp(h->epk, epk, CAL_SEG_EPK_SIZE) == 0;
+    if (!gCalSegFileValid) { // New file or different EPK, start with the default pages
+        memset(h, 0, sizeof(tCalSegFileHeader));
+        h->magic = CAL_SEG_FILE_MAGIC;
+        h->version = CAL_SEG_FILE_VERSION;
+        strncpy(h->epk, epk, CAL_SEG_EPK_SIZE - 1);
+    }
+    gCalSegFileOffset = sizeof(tCalSegFileHeader);
+    DBG_PRINTF3("Calibration pages file %s mapped, %s\n", filename, gCalSegFileValid ? "valid" : "initialized with default pages");
+    return TRUE;
+}
+
+void calSegCloseFile() {
+
+    if (gCalSegFile == NULL) return;
+    for (tCalSegIndex i = 0; i < gCalSegCount; i++) gCalSeg[i].file_page = NULL;
+    memoryUnmapFile(gCalSegFile, CAL_SEG_FILE_SIZE);
+    gCalSegFile = NULL;
+}
+
+// Assign the next record in the file to a new segment, initialize its RAM pages from the record if it is valid
+static void calSegLoadFilePage(tCalSeg* s) {
+
+    uint32_t n = (uint32_t)(sizeof(tCalSegFileRecord) + CAL_SEG_FILE_ALIGN(s->size));
+    if (gCalSegFileOffset + n > CAL_SEG_FILE_SIZE) {
+        DBG_PRINTF_ERROR("ERROR: Calibration pages file full, %s is not persistent!\n", s->name);
+        return;
+    }
+    tCalSegFileRecord* r = (tCalSegFileRecord*)(gCalSegFile + gCalSegFileOffset);
+    s->file_page = (uint8_t*)(r + 1);
+    if (gCalSegFileValid && r->size == s->size && strncmp(r->name, s->name, sizeof(r->name) - 1) == 0) { // Names are stored truncated
+        memcpy(s->ram_page[0], s->file_page, s->size);
+        memcpy(s->ram_page[1], s->file_page, s->size);
+        DBG_PRINTF3("Calibration segment %s loaded from file\n", s->name);
+    }
+    else { // The layout changed, this and all following records are reinitialized
+        gCalSegFileValid = FALSE;
+        memset(r, 0, sizeof(tCalSegFileRecord));
+        r->size = s->size;
+        strncpy(r->name, s->name, sizeof(r->name) - 1);
+        memcpy(s->file_page, s->default_page, s->size);
+    }
+    gCalSegFileOffset += n;
+}
+
+
+// Number of segments with a default page address <= a
+static tCalSegIndex calSegUpperBound(const uint8_t* a) {
+
+    tCalSegIndex l = 0, h = gCalSegCount;
+    while (l < h) {
+        tCalSegIndex m = (tCalSegIndex)((l + h) / 2);
+        if (gCalSeg[gCalSegSorted[m]].default_page <= a) l = (tCalSegIndex)(m + 1); else h = m;
+    }
+    return l;
+}
+
+tCalSegIndex calSegCreate(const char* name, const void* default_page, uint32_t size) {
+
+    const uint8_t* p = (const uint8_t*)default_page;
+
+    if (gCalSegCount >= CAL_SEG_MAX) {
+        DBG_PRINTF_ERROR("ERROR: Too many calibration segments, %s not created!\n", name);
+        return CAL_SEG_INVALID;
+    }
+    tCalSegIndex i = calSegUpperBound(p); // Insert position in the sorted index
+    if ((i > 0 && gCalSeg[gCalSegSorted[i - 1]].default_page + gCalSeg[gCalSegSorted[i - 1]].size > p) ||
+        (i < gCalSegCount && gCalSeg[gCalSegSorted[i]].default_page < p + size)) {
+        DBG_PRINTF_ERROR("ERROR: Calibration segment %s overlaps an existing segment, not created!\n", name);
+        return CAL_SEG_INVALID;
+    }
+    tCalSeg* s = &gCalSeg[gCalSegCount];
+    s->name = name;
+    s->default_page = (uint8_t*)default_page;
+    s->size = size;
+    for (int j = 0; j < 2; j++) {
+        s->ram_page[j] = (uint8_t*)malloc(size);
+        if (s->ram_page[j] == NULL) return CAL_SEG_INVALID;
+        memcpy(s->ram_page[j], default_page, size);
+        s->readers[j] = 0;
+    }
+    s->active = 0;
+    s->ecu_page = s->xcp_page = CAL_SEG_PAGE_RAM;
+    s->freeze = FALSE;
+    s->file_page = NULL;
+    if (gCalSegFile != NULL) calSegLoadFilePage(s);
+    memmove(&gCalSegSorted[i + 1], &gCalSegSorted[i], (size_t)(gCalSegCount - i) * sizeof(tCalSegIndex));
+    gCalSegSorted[i] = gCalSegCount;
+    DBG_PRINTF3("Create calibration segment %u %s, size=%u\n", gCalSegCount, name, size);
+    return gCalSegCount++;
+}
+
+tCalSegIndex calSegCount() {
+    return gCalSegCount;
+}
+
+
+// Application read access
+// The reader count is incremented before the active page index is confirmed, calSegPublish swaps the index before it checks the count
+
+const void* calSegLock(tCalSegIndex seg) {
+
+    tCalSeg* s = &gCalSeg[seg];
+    uint32_t a;
+
+    assert(seg < gCalSegCount);
+    if (s->ecu_page == CAL_SEG_PAGE_ROM) return s->default_page;
+    for (;;) {
+        a = atomicLoad32(&s->active);
+        atomicAdd32(&s->readers[a], 1);
+        if (atomicLoad32(&s->active) == a) return s->ram_page[a];
+        atomicSub32(&s->readers[a], 1); // Pages have been swapped meanwhile
+    }
+}
+
+void calSegUnlock(tCalSegIndex seg, const void* page) {
+
+    tCalSeg* s = &gCalSeg[seg];
+
+    if (page == s->ram_page[0]) atomicSub32(&s->readers[0], 1);
+    else if (page == s->ram_page[1]) atomicSub32(&s->readers[1], 1);
+}
+
+
+// XCP access
+
+// Wait until all readers have left the working page (the active page before the last swap) and update it from the active page
+// Gives up after timeoutMs and marks the segment pending, the update is retried on the next XCP access or publish
+static BOOL calSegUpdateWorkingPage(tCalSeg* s, uint32_t timeoutMs) {
+
+    uint32_t a = s->active;
+    uint32_t w = a ^ 1;
+    uint64_t t = clockGet64();
+
+    while (atomicLoad32(&s->readers[w]) != 0) {
+        if (clockGet64() - t >= (uint64_t)timeoutMs * CLOCK_TICKS_PER_MS) {
+            if (!s->pending) DBG_PRINTF_ERROR("ERROR: Calibration segment %s locked by a reader for more than %ums!\n", s->name, timeoutMs);
+            s->pending = TRUE;
+            return FALSE;
+        }
+        sleepNs(10000);
+    }
+    memcpy(s->ram_page[w], s->ram_page[a], s->size);
+    s->pending = FALSE;
+    return TRUE;
+}
+
+// Binary search in the sorted segment index
+uint8_t* calSegAddrMapping(uint8_t* a) {
+
+    tCalSegIndex i = calSegUpperBound(a);
+    if (i == 0) return a;
+    tCalSeg* s = &gCalSeg[gCalSegSorted[i - 1]];
+    if (a >= s->default_page + s->size) return a;
+    if (s->xcp_page == CAL_SEG_PAGE_ROM) return a;
+    if (s->pending && !calSegUpdateWorkingPage(s, 0)) return NULL; // Working page not accessible yet
+    return s->ram_page[s->active ^ 1] + (a - s->default_page); // Working page
+}
+
+// Swap active and working page, the old active page becomes the new working page
+static BOOL calSegPublishPage(tCalSeg* s) {
+
+    uint32_t a, w;
+
+    if (s->pending && !calSegUpdateWorkingPage(s, CAL_SEG_PUBLISH_TIMEOUT_MS)) return FALSE; // Previous publish not completed
+    a = s->active;
+    w = a ^ 1;
+    if (memcmp(s->ram_page[w], s->ram_page[a], s->size) == 0) return TRUE; // Not modified
+    atomicStore32(&s->active, w);
+    atomicFence();
+    return calSegUpdateWorkingPage(s, CAL_SEG_PUBLISH_TIMEOUT_MS);
+}
+
+BOOL calSegPublish() {
+
+    BOOL ok = TRUE;
+    for (tCalSegIndex i = 0; i < gCalSegCount; i++) {
+        if (!calSegPublishPage(&gCalSeg[i])) ok = FALSE;
+    }
+    return ok;
+}
+
+BOOL calSegSetPage(tCalSegIndex seg, uint8_t page, BOOL ecu, BOOL xcp) {
+
+    if (seg >= gCalSegCount || page > CAL_SEG_PAGE_ROM) return FALSE;
+    if (ecu) gCalSeg[seg].ecu_page = page;
+    if (xcp) gCalSeg[seg].xcp_page = page;
+    return TRUE;
+}
+
+uint8_t calSegGetPage(tCalSegIndex seg, BOOL xcp) {
+
+    if (seg >= gCalSegCount) return CAL_SEG_PAGE_ROM;
+    return xcp ? gCalSeg[seg].xcp_page : gCalSeg[seg].ecu_page;
+}
+
+BOOL calSegSetFreeze(tCalSegIndex seg, BOOL freeze) {
+
+    if (seg >= gCalSegCount) return FALSE;
+    gCalSeg[seg].freeze = freeze;
+    return TRUE;
+}
+
+BOOL calSegGetFreeze(tCalSegIndex seg) {
+
+    return seg < gCalSegCount && gCalSeg[seg].freeze;
+}
+
+// The active pages are not modified outside of the XCP command context, no lock needed
+BOOL calSegFreeze() {
+
+    if (gCalSegFile == NULL) return FALSE;
+    for (tCalSegIndex i = 0; i < gCalSegCount; i++) {
+        tCalSeg* s = &gCalSeg[i];
+        if (s->freeze && s->file_page != NULL) {
+            memcpy(s->file_page, s->ram_page[s->active], s->size);
+            DBG_PRINTF3("Calibration segment %s stored\n", s->name);
+        }
+    }
+    return memoryMapSync(gCalSegFile, gCalSegFileOffset);
+}
+
+// Copy a page into the working page of a segment with the same size, visible to the application after the next calSegPublish
+BOOL calSegCopyPage(tCalSegIndex srcSeg, uint8_t srcPage, tCalSegIndex dstSeg) {
+
+    if (srcSeg >= gCalSegCount || dstSeg >= gCalSegCount || srcPage > CAL_SEG_PAGE_ROM) return FALSE;
+    tCalSeg* s = &gCalSeg[srcSeg];
+    tCalSeg* d = &gCalSeg[dstSeg];
+    if (s->size != d->size) return FALSE;
+    const uint8_t* src = (srcPage == CAL_SEG_PAGE_ROM) ? s->default_page : s->ram_page[s->active ^ 1];
+    if (d->pending && !calSegUpdateWorkingPage(d, 0)) return FALSE;
+    uint8_t* dst = d->ram_page[d->active ^ 1];
+    if (src != dst) memcpy(dst, src, d->size);
+    return TRUE;
+}
+
+const char* calSegGetName(tCalSegIndex seg) {
+    return seg < gCalSegCount ? gCalSeg[seg].name : NULL;
+}
+
+const uint8_t* calSegGetAddr(tCalSegIndex seg) {
+    return seg < gCalSegCount ? gCalSeg[seg].default_page : NULL;
+}
+
+uint32_t calSegGetSize(tCalSegIndex seg) {
+    return seg < gCalSegCount ? gCalSeg[seg].size : 0;
+}
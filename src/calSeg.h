@@ -0,0 +1,52 @@
+#pragma once
+/* calSeg.h */
+
+/* Calibration segments with double buffered RAM pages
+   A calibration segment is a parameter struct with a default page (ROM, compiled default values, the A2L addresses refer to it)
+   and two RAM pages: the active page read by the application and the working page written by XCP.
+   Modifications are published atomically by swapping the RAM pages. The old active page becomes the new working page,
+   when all readers have left it (passed their quiescent point calSegUnlock).
+   Optionally, the RAM pages are persistent in a memory mapped file, which is valid for one EPK.
+   At startup, the RAM pages are initialized from the file, a freeze stores the active pages in the file.
+
+   Code released into public domain, no attribution required */
+
+#define CAL_SEG_MAX 64 // Max number of calibration segments
+#define CAL_SEG_INVALID 0xFFFF
+
+#define CAL_SEG_FILE_SIZE (1024*1024) // Max size of the persistent calibration pages file
+#define CAL_SEG_EPK_SIZE 64 // Max EPK length stored in the file header
+#define CAL_SEG_PUBLISH_TIMEOUT_MS 100 // Max time calSegPublish waits for readers to leave the old active page
+
+#define CAL_SEG_PAGE_RAM 0
+#define CAL_SEG_PAGE_ROM 1
+
+typedef uint16_t tCalSegIndex;
+
+// Map the persistent calibration pages file, call before the segments are created
+// The file content is used, if it has been written by an application with the same EPK and the same sequence of segments
+extern BOOL calSegOpenFile(const char* filename, const char* epk);
+extern void calSegCloseFile();
+
+// Create a calibration segment for the parameter struct at default_page, the RAM pages are initialized with the default values
+// Segments are registered at startup, before the XCP client connects, they must not overlap
+extern tCalSegIndex calSegCreate(const char* name, const void* default_page, uint32_t size);
+extern tCalSegIndex calSegCount();
+extern const char* calSegGetName(tCalSegIndex seg);
+extern const uint8_t* calSegGetAddr(tCalSegIndex seg); // Default page address
+extern uint32_t calSegGetSize(tCalSegIndex seg);
+
+// Application read access
+// Returns a consistent page, which is not modified until calSegUnlock, do not hold it longer than one task cycle
+extern const void* calSegLock(tCalSegIndex seg);
+extern void calSegUnlock(tCalSegIndex seg, const void* page);
+
+// XCP access, called in the XCP command context only, commands of multiple XCP server instances are serialized by the protocol layer
+extern uint8_t* calSegAddrMapping(uint8_t* a); // Map a default page address to the page selected for XCP access, NULL if the working page is still locked by a reader
+extern BOOL calSegPublish(); // Consistency point, make the modified working pages visible to the application, FALSE if a reader did not leave the old active page in time
+extern BOOL calSegSetPage(tCalSegIndex seg, uint8_t page, BOOL ecu, BOOL xcp); // Select the page for application and/or XCP access
+extern uint8_t calSegGetPage(tCalSegIndex seg, BOOL xcp);
+extern BOOL calSegSetFreeze(tCalSegIndex seg, BOOL freeze); // Select the segment for the next calSegFreeze
+extern BOOL calSegGetFreeze(tCalSegIndex seg);
+extern BOOL calSegFreeze(); // Store the active pages of all segments in freeze mode in the file and flush it
+extern BOOL calSegCopyPage(tCalSegIndex srcSeg, uint8_t srcPage, tCalSegIndex dstSeg); // Copy to the working page of dstSeg
@@ -14,11 +14,21 @@
 |   Code released into public domain, no attribution required
  ----------------------------------------------------------------------------*/
 
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // pthread_setaffinity_np
+#endif
+
 #include "main.h"
 #include "main_cfg.h"
 #include "platform.h"
 #include "util.h"
 
+#ifdef _LINUX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
 
 #ifdef _WIN // Windows needs to link with Ws2_32.lib
 
@@ -125,6 +135,187 @@ void sleepMs(uint32_t ms) {
 #endif // Windows
 
 
+/**************************************************************************/
+// Threads
+/**************************************************************************/
+
+#ifdef _LINUX
+
+BOOL threadConfigure(tXcpThread h, const tThreadConfig* config) {
+
+    struct sched_param param;
+    int policy, r;
+
+    memset(&param, 0, sizeof(param));
+    switch (config->policy) {
+    case THREAD_SCHED_FIFO: policy = SCHED_FIFO; param.sched_priority = config->priority; break;
+    case THREAD_SCHED_RR: policy = SCHED_RR; param.sched_priority = config->priority; break;
+    default: policy = SCHED_OTHER; break;
+    }
+    r = pthread_setschedparam(h, policy, &param);
+    if (r != 0) {
+        DBG_PRINTF_ERROR("ERROR %d: pthread_setschedparam failed (policy=%u, priority=%u)!\n", r, config->policy, config->priority);
+        return FALSE;
+    }
+    if (config->cpuMask != 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int i = 0; i < 64 && i < CPU_SETSIZE; i++) {
+            if (config->cpuMask & (1ULL << i)) CPU_SET(i, &cpus);
+        }
+        r = pthread_setaffinity_np(h, sizeof(cpus), &cpus);
+        if (r != 0) {
+            DBG_PRINTF_ERROR("ERROR %d: pthread_setaffinity_np failed (mask=%" PRIx64 ")!\n", r, config->cpuMask);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+BOOL memoryLock() {
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        DBG_PRINTF_ERROR("ERROR %d: mlockall failed!\n", errno);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+uint8_t* memoryReserve(uint32_t size) {
+
+    void* p = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        DBG_PRINTF_ERROR("ERROR %d: mmap failed!\n", errno);
+        return NULL;
+    }
+    return (uint8_t*)p;
+}
+
+BOOL memoryCommit(uint8_t* p, uint32_t size) {
+
+    if (mprotect(p, size, PROT_READ | PROT_WRITE) != 0) {
+        DBG_PRINTF_ERROR("ERROR %d: mprotect failed!\n", errno);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+uint8_t* memoryMapFile(const char* filename, uint32_t size) {
+
+    struct stat st;
+    void* p = MAP_FAILED;
+
+    int fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        DBG_PRINTF_ERROR("ERROR %d: open %s failed!\n", errno, filename);
+        return NULL;
+    }
+    if (fstat(fd, &st) == 0 && (st.st_size >= (off_t)size || ftruncate(fd, (off_t)size) == 0)) {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (p == MAP_FAILED) DBG_PRINTF_ERROR("ERROR %d: mmap %s failed!\n", errno, filename);
+    close(fd); // The mapping keeps the file open
+    return p == MAP_FAILED ? NULL : (uint8_t*)p;
+}
+
+BOOL memoryMapSync(uint8_t* p, uint32_t size) {
+
+    uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uint8_t* b = (uint8_t*)((uintptr_t)p & ~(pageSize - 1)); // msync needs a page aligned address
+    if (msync(b, (size_t)(p + size - b), MS_SYNC) != 0) {
+        DBG_PRINTF_ERROR("ERROR %d: msync failed!\n", errno);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void memoryUnmapFile(uint8_t* p, uint32_t size) {
+
+    munmap(p, size);
+}
+
+#else
+
+BOOL threadConfigure(tXcpThread h, const tThreadConfig* config) {
+
+    int priority;
+
+    switch (config->policy) {
+    case THREAD_SCHED_FIFO:
+    case THREAD_SCHED_RR: priority = config->priority >= 50 ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST; break;
+    default: priority = THREAD_PRIORITY_NORMAL; break;
+    }
+    if (!SetThreadPriority(h, priority)) {
+        DBG_PRINTF_ERROR("ERROR %u: SetThreadPriority failed!\n", GetLastError());
+        return FALSE;
+    }
+    if (config->cpuMask != 0 && SetThreadAffinityMask(h, (DWORD_PTR)config->cpuMask) == 0) {
+        DBG_PRINTF_ERROR("ERROR %u: SetThreadAffinityMask failed!\n", GetLastError());
+        return FALSE;
+    }
+    return TRUE;
+}
+
+BOOL memoryLock() {
+
+    DBG_PRINT_ERROR("ERROR: memoryLock not supported!\n");
+    return FALSE;
+}
+
+uint8_t* memoryReserve(uint32_t size) {
+
+    return (uint8_t*)VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+BOOL memoryCommit(uint8_t* p, uint32_t size) {
+
+    return VirtualAlloc(p, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+uint8_t* memoryMapFile(const char* filename, uint32_t size) {
+
+    void* p = NULL;
+
+    HANDLE hf = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hf == INVALID_HANDLE_VALUE) {
+        DBG_PRINTF_ERROR("ERROR %u: CreateFile %s failed!\n", GetLastError(), filename);
+        return NULL;
+    }
+    HANDLE hm = CreateFileMappingA(hf, NULL, PAGE_READWRITE, 0, size, NULL); // Extends the file to size
+    if (hm != NULL) {
+        p = MapViewOfFile(hm, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        CloseHandle(hm); // The view keeps the mapping and the file open
+    }
+    if (p == NULL) DBG_PRINTF_ERROR("ERROR %u: MapViewOfFile %s failed!\n", GetLastError(), filename);
+    CloseHandle(hf);
+    return (uint8_t*)p;
+}
+
+BOOL memoryMapSync(uint8_t* p, uint32_t size) {
+
+    if (!FlushViewOfFile(p, size)) {
+        DBG_PRINTF_ERROR("ERROR %u: FlushViewOfFile failed!\n", GetLastError());
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void memoryUnmapFile(uint8_t* p, uint32_t size) {
+
+    (void)size;
+    UnmapViewOfFile(p);
+}
+
+#endif
+
+void threadPrefaultStack() {
+
+    volatile uint8_t stack[THREAD_STACK_PREFAULT_SIZE];
+    for (uint32_t i = 0; i < THREAD_STACK_PREFAULT_SIZE; i += 1024) stack[i] = 0;
+    (void)stack[0];
+}
+
+
 /**************************************************************************/
 // Mutex
 /**************************************************************************/
@@ -898,3 +1089,94 @@ uint64_t clockGet64() {
 
 #endif // Windows
 
+
+
+/**************************************************************************/
+// Cyclic task
+/**************************************************************************/
+
+// Monotonic time in ns, not affected by clock adjustments
+uint64_t clockGetMonotonicNs() {
+#ifdef _LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#else
+    return clockGet64() * (1000000000ULL / CLOCK_TICKS_PER_S);
+#endif
+}
+
+// Sleep until the absolute monotonic time t in ns
+void sleepUntilNs(uint64_t t) {
+#ifdef _LINUX
+    struct timespec ts;
+    ts.tv_sec = (time_t)(t / 1000000000ULL);
+    ts.tv_nsec = (long)(t % 1000000000ULL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+#else
+    uint64_t c = clockGetMonotonicNs();
+    if (t > c) sleepNs((uint32_t)(t - c));
+#endif
+}
+
+void cyclicTaskInit(tCyclicTask* t, const char* name, uint32_t cycleUs, uint8_t policy) {
+
+    memset(t, 0, sizeof(tCyclicTask));
+    t->name = name;
+    t->cycleUs = cycleUs;
+    t->policy = policy;
+}
+
+// End the current activation and sleep until the next activation is due
+// The activations are on an absolute time grid, execution time does not add drift
+void cyclicTaskWait(tCyclicTask* t) {
+
+    uint64_t c, n, cycle;
+
+    c = clockGetMonotonicNs();
+    cycle = (uint64_t)t->cycleUs * 1000;
+    if (cycle == 0) cycle = 1000; // At least 1us, the cycle time may be a calibration parameter without limit check
+    if (t->count == 0) { // First activation one cycle from now
+        t->next = c + cycle;
+    }
+    else {
+        n = c - t->start; // Execution time of the current activation
+        if (n > t->execMax) t->execMax = n;
+        t->execSum += n;
+        t->next += cycle;
+        if (t->next < c) { // Overrun, the next activation is already late
+            t->overruns++;
+            switch (t->policy) {
+            case CYCLIC_TASK_SKIP: // Skip the missed cycles
+                n = (c - t->next) / cycle + 1;
+                t->next += n * cycle;
+                t->missed += n;
+                break;
+            case CYCLIC_TASK_RESYNC: // Restart the time grid now
+                t->next = c;
+                break;
+            default: // CYCLIC_TASK_CATCH_UP, start immediately
+                break;
+            }
+        }
+    }
+
+    sleepUntilNs(t->next);
+
+    // Activation latency
+    t->start = clockGetMonotonicNs();
+    n = t->start > t->next ? t->start - t->next : 0;
+    if (t->count == 0 || n < t->jitterMin) t->jitterMin = n;
+    if (n > t->jitterMax) t->jitterMax = n;
+    t->jitterSum += n;
+    t->count++;
+}
+
+void cyclicTaskPrintStatistics(const tCyclicTask* t) {
+
+    uint64_t activations = t->count > 0 ? t->count : 1;
+    uint64_t executions = t->count > 1 ? t->count - 1 : 1;
+    printf("Task %s: cycle=%uus, activations=%" PRIu64 ", overruns=%" PRIu64 ", missed=%" PRIu64 ", jitter min/avg/max=%" PRIu64 "/%" PRIu64 "/%" PRIu64 "ns, execution avg/max=%" PRIu64 "/%" PRIu64 "ns\n",
+        t->name, t->cycleUs, t->count, t->overruns, t->missed,
+        t->jitterMin, t->jitterSum / activations, t->jitterMax, t->execSum / executions, t->execMax);
+}
@@ -62,6 +62,30 @@ void mutexInit(MUTEX* m, BOOL recursive, uint32_t spinCount);
 void mutexDestroy(MUTEX* m);
 
 
+//-------------------------------------------------------------------------------
+// Atomic operations and memory barriers
+
+#ifdef _LINUX
+
+#define atomicLoad32(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define atomicStore32(p,v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define atomicFence() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define atomicExchange32(p,v) __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#define atomicAdd32(p,v) __atomic_add_fetch((p), (v), __ATOMIC_SEQ_CST)
+#define atomicSub32(p,v) __atomic_sub_fetch((p), (v), __ATOMIC_SEQ_CST)
+
+#elif defined (_WIN)
+
+#define atomicLoad32(p) ((uint32_t)InterlockedOr((volatile LONG*)(p), 0))
+#define atomicStore32(p,v) InterlockedExchange((volatile LONG*)(p), (LONG)(v))
+#define atomicFence() MemoryBarrier()
+#define atomicExchange32(p,v) ((uint32_t)InterlockedExchange((volatile LONG*)(p), (LONG)(v)))
+#define atomicAdd32(p,v) ((uint32_t)InterlockedExchangeAdd((volatile LONG*)(p), (LONG)(v)) + (v))
+#define atomicSub32(p,v) ((uint32_t)InterlockedExchangeAdd((volatile LONG*)(p), -(LONG)(v)) - (v))
+
+#endif
+
+
 //-------------------------------------------------------------------------------
 // Threads
 
@@ -69,6 +93,8 @@ void mutexDestroy(MUTEX* m);
 
 typedef HANDLE tXcpThread;
 #define create_thread(h,t) *h = CreateThread(0, 0, t, NULL, 0, NULL)
+#define create_thread_arg(h,t,p) *h = CreateThread(0, 0, t, p, 0, NULL)
+#define THREAD_LOCAL __declspec(thread)
 #define join_thread(h) WaitForSingleObject(h, INFINITE);
 #define cancel_thread(h) { TerminateThread(h,0); WaitForSingleObject(h,1000); CloseHandle(h); }
 
@@ -76,11 +102,42 @@ typedef HANDLE tXcpThread;
 
 typedef pthread_t tXcpThread;
 #define create_thread(h,t) pthread_create(h, NULL, t, NULL);
+#define create_thread_arg(h,t,p) pthread_create(h, NULL, t, p);
+#define THREAD_LOCAL __thread
 #define join_thread(h) pthread_join(h);
 #define cancel_thread(h) { pthread_detach(h); pthread_cancel(h); }
 
 #endif
 
+// Thread scheduling configuration
+#define THREAD_SCHED_DEFAULT 0 // Time sharing, default priority
+#define THREAD_SCHED_FIFO 1 // Real time, first in first out
+#define THREAD_SCHED_RR 2 // Real time, round robin
+typedef struct {
+    uint8_t policy;     // THREAD_SCHED_xxx
+    uint8_t priority;   // Real time priority 1..99, ignored for THREAD_SCHED_DEFAULT
+    uint64_t cpuMask;   // CPU affinity mask, 0 = no affinity
+} tThreadConfig;
+extern BOOL threadConfigure(tXcpThread h, const tThreadConfig* config);
+
+// Touch the stack of the calling thread to avoid page faults later
+#define THREAD_STACK_PREFAULT_SIZE (64*1024)
+extern void threadPrefaultStack();
+
+// Lock all current and future pages of the process in memory
+extern BOOL memoryLock();
+
+// Reserve address space, commit the first size bytes of a reservation
+// Committed memory never moves
+extern uint8_t* memoryReserve(uint32_t size);
+extern BOOL memoryCommit(uint8_t* p, uint32_t size);
+
+// Map a file shared into memory, the file is created or extended to size bytes, new bytes are zero
+// memoryMapSync writes the modified pages in the range to the file and waits for completion
+extern uint8_t* memoryMapFile(const char* filename, uint32_t size);
+extern BOOL memoryMapSync(uint8_t* p, uint32_t size);
+extern void memoryUnmapFile(uint8_t* p, uint32_t size);
+
 
 //-------------------------------------------------------------------------------
 // Platform independant socket functions
@@ -159,4 +216,39 @@ extern BOOL socketGetLocalAddr(uint8_t* mac, uint8_t* addr);
 // Clock
 extern BOOL clockInit();
 extern char* clockGetString(char* s, uint32_t l, uint64_t c);
-extern uint64_t clockGet64();
\ No newline at end of file
+extern uint64_t clockGet64();
+
+
+//-------------------------------------------------------------------------------
+// Cyclic task
+
+// Monotonic time in ns and delay until an absolute monotonic time, time domain different from clockGet64
+extern uint64_t clockGetMonotonicNs();
+extern void sleepUntilNs(uint64_t t);
+
+// Overrun policy, when the execution of a cyclic task ends after its next activation is due
+#define CYCLIC_TASK_SKIP     0 // Skip the missed activations and stay on the time grid
+#define CYCLIC_TASK_CATCH_UP 1 // Execute the missed activations back to back
+#define CYCLIC_TASK_RESYNC   2 // Start the next activation immediately and restart the time grid
+
+// Cyclic task activated on an absolute time grid, with jitter and execution time statistics
+// Usage: cyclicTaskInit(&t, ...); for (;;) { cyclicTaskWait(&t); work(); }
+typedef struct {
+    const char* name;
+    uint32_t cycleUs;             // Cycle time, may be modified by the task, effective for the next activation
+    uint8_t policy;               // Overrun policy
+    uint64_t next;                // Activation time in monotonic ns
+    uint64_t start;
+    uint64_t count;               // Number of activations
+    uint64_t overruns;            // Number of executions which ended after the next activation was due
+    uint64_t missed;              // Number of skipped activations
+    uint64_t jitterMin;           // Activation latency in ns
+    uint64_t jitterMax;
+    uint64_t jitterSum;
+    uint64_t execMax;             // Execution time in ns
+    uint64_t execSum;
+} tCyclicTask;
+
+extern void cyclicTaskInit(tCyclicTask* t, const char* name, uint32_t cycleUs, uint8_t policy);
+extern void cyclicTaskWait(tCyclicTask* t);
+extern void cyclicTaskPrintStatistics(const tCyclicTask* t);
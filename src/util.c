@@ -92,6 +92,8 @@ uint32_t gDebugLevel = OPTION_DEBUG_LEVEL;
 BOOL gOptionUseTCP = OPTION_USE_TCP;
 uint16_t gOptionPort = OPTION_SERVER_PORT;
 uint8_t gOptionAddr[4] = OPTION_SERVER_ADDR;
+uint8_t gOptionRtPriority = 0;
+uint64_t gOptionCpuMask = 0;
 
 #if OPTION_ENABLE_XLAPI_V3
 
@@ -127,6 +129,8 @@ void cmdline_usage(const char* appName) {
         "    -dx              Set output verbosity to x (default is 1)\n"
         "    -bind <ipaddr>   IP address to bind (default is ANY (0.0.0.0))\n"
         "    -port <portname> Server port (default is 5555)\n"
+        "    -rt <priority>   Real time scheduling (SCHED_FIFO) and memory locking for the XCP server threads\n"
+        "    -cpu <mask>      CPU affinity mask for the XCP server threads (hex)\n"
 #if OPTION_ENABLE_TCP
 #if OPTION_USE_TCP
         "    -udp             Use UDP\n"
@@ -189,6 +193,18 @@ BOOL cmdline_parser(int argc, char* argv[]) {
                 }
             }
         }
+        else if (strcmp(argv[i], "-rt") == 0) {
+            unsigned int p;
+            if (++i < argc && sscanf(argv[i], "%u", &p) == 1 && p >= 1 && p <= 99) {
+                gOptionRtPriority = (uint8_t)p;
+                printf("Set XCP server thread real time priority to %u\n", gOptionRtPriority);
+            }
+        }
+        else if (strcmp(argv[i], "-cpu") == 0) {
+            if (++i < argc && sscanf(argv[i], "%" SCNx64, &gOptionCpuMask) == 1) {
+                printf("Set XCP server thread CPU affinity mask to %" PRIx64 "\n", gOptionCpuMask);
+            }
+        }
 #if OPTION_ENABLE_TCP
         else if (strcmp(argv[i], "-tcp") == 0) {
             gOptionUseTCP = TRUE;
@@ -21,6 +21,8 @@ extern uint32_t gDebugLevel;
 extern BOOL gOptionUseTCP;
 extern uint16_t gOptionPort;
 extern uint8_t gOptionAddr[4];
+extern uint8_t gOptionRtPriority;
+extern uint64_t gOptionCpuMask;
 #if OPTION_ENABLE_XLAPI_V3
 extern BOOL gOptionUseXLAPI;
 extern uint8_t gOptionXlServerAddr[4];
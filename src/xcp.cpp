@@ -205,6 +205,7 @@ XcpObject::XcpObject(const char* instanceName, const char* className, int classS
     this->instanceName = instanceName;
     this->className = className;
     this->classSize = classSize;
+    this->registered = FALSE;
 
     // Create a XCP extended event for this instance
     // The event number is unique and will be the instance id used in A2L addresses
@@ -219,6 +220,29 @@ XcpObject::XcpObject(const char* instanceName, const char* className, int classS
 }
 
 
+XcpObject::~XcpObject() {
+
+    xcpUnregister(); // Fallback, the members of derived classes are already destroyed here
+}
+
+void XcpObject::xcpUnregister() {
+
+#ifdef XCP_ENABLE_DYN_ADDRESSING
+    if (registered) XcpUnregisterInstance(instanceId); // Wait until direct accesses in progress are finished
+#endif
+    registered = FALSE;
+}
+
+void XcpObject::xcpRegister(BOOL consistent) {
+
+#ifdef XCP_ENABLE_DYN_ADDRESSING
+    registered = XcpRegisterInstance(instanceId, (uint8_t*)this, (uint32_t)classSize, consistent ? XCP_INSTANCE_CONSISTENT : XCP_INSTANCE_DIRECT);
+#else
+    (void)consistent;
+#endif
+}
+
+
 void XcpObject::a2lCreateTypedef() {
 
 #if OPTION_ENABLE_A2L_GEN
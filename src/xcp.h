@@ -479,6 +479,7 @@
 #define CRM_GET_STATUS_LEN                              6
 #define CRM_GET_STATUS_STATUS                           CRM_BYTE(1)
 #define CRM_GET_STATUS_PROTECTION                       CRM_BYTE(2)
+#define CRM_GET_STATUS_STATE_NUMBER                     CRM_BYTE(3)
 #define CRM_GET_STATUS_CONFIG_ID                        CRM_WORD(2)
 
 /* SYNCH */
@@ -512,6 +513,12 @@
 #define CRO_SET_REQUEST_CONFIG_ID                       CRO_WORD(1)
 #define CRM_SET_REQUEST_LEN                             1
 
+/* SET_REQUEST Mode Bitmasks */
+#define SET_REQUEST_STORE_CAL_REQ                       0x01
+#define SET_REQUEST_STORE_DAQ_REQ_NO_RESUME             0x02
+#define SET_REQUEST_STORE_DAQ_REQ_RESUME                0x04
+#define SET_REQUEST_CLEAR_DAQ_REQ                       0x08
+
 
 /* GET_SEED */
 #define CRO_GET_SEED_LEN                                3
@@ -619,6 +626,12 @@
 #define CRM_GET_CAL_PAGE_PAGE                           CRM_BYTE(3)
 
 
+/* USER_CMD */
+#define CRO_USER_CMD_LEN                                2
+#define CRO_USER_CMD_SUBCOMMAND                         CRO_BYTE(1)
+#define CRM_USER_CMD_LEN                                1
+
+
 /* GET_PAG_PROCESSOR_INFO */
 #define CRO_GET_PAG_PROCESSOR_INFO_LEN                  1
 #define CRM_GET_PAG_PROCESSOR_INFO_LEN                  3
@@ -1016,9 +1029,12 @@
 
 
 /* GET_DAQ_LIST_PACKED_MODE */
-#define CRO_GET_DAQ_LIST_PACKED_MODE_DAQ                    CRM_WORD(1)
-#define CRM_GET_DAQ_LIST_PACKED_MODE_LEN                    8
+#define CRO_GET_DAQ_LIST_PACKED_MODE_DAQ                    CRO_WORD(1)
+#define CRM_GET_DAQ_LIST_PACKED_MODE_LEN                    6
+#define CRM_GET_DAQ_LIST_PACKED_MODE_RES                    CRM_BYTE(1)
 #define CRM_GET_DAQ_LIST_PACKED_MODE_MODE                   CRM_BYTE(2)
+#define CRM_GET_DAQ_LIST_PACKED_MODE_TIMEMODE               CRM_BYTE(3)
+#define CRM_GET_DAQ_LIST_PACKED_MODE_SAMPLECOUNT            CRM_WORD(2)
 
 
 /* SET_DAQ_LIST_PACKED_MODE */
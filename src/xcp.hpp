@@ -115,6 +115,7 @@ private:
 	uint16_t instanceId;
 	const char* className;
 	int classSize;
+	BOOL registered;
 
 protected:
 	const char* instanceName;
@@ -128,6 +129,16 @@ public:
 
 	// Create an A2L INSTANCE (instanceName) for the class with className/classSize
 	XcpObject(const char* instanceName, const char* className, int classSize);
+	virtual ~XcpObject();
+
+	// Register this object as live instance, calibration is written directly from the XCP command thread
+	// consistent = TRUE: calibration is written in the context of xcpEvent()
+	// Objects created with XcpDynObject are virtual instances, which are not registered
+	void xcpRegister(BOOL consistent = FALSE);
+
+	// Unregister this object, waits until direct accesses in progress are finished
+	// Derived classes must call it first in their destructor, before their members are destroyed
+	void xcpUnregister();
 
 	// Create the typedef (A2L TYPEDEF_STRUCTURE) for this class, calls a2lCreateTypedefComponents to add components 
 	void a2lCreateTypedef();
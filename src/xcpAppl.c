@@ -21,7 +21,7 @@
 #include "xcp.hpp"
 #else
 #if OPTION_ENABLE_CAL_SEGMENT
-#include "ecu.h"
+#include "calSeg.h"
 #endif
 #endif
 
@@ -159,11 +159,152 @@ BOOL ApplXcpGetClockInfoGrandmaster(uint8_t* uuid, uint8_t* epoch, uint8_t* stra
 
 #define XCP_ENABLE_MEMORY_CHECK
 #ifdef XCP_ENABLE_MEMORY_CHECK
-BOOL check(uint8_t *p)
-{
-    (void)p;
+
+// Memory access check for XCP memory and DAQ addresses
+// Called in the XCP command context only, XCP commands are serialized
+
+#ifdef _WIN
+
+BOOL ApplXcpCheckMemory(const uint8_t* p, uint32_t size, BOOL write) {
+
+    MEMORY_BASIC_INFORMATION m;
+    const uint8_t* end = p + (size > 0 ? size : 1);
+    DWORD r = PAGE_READONLY | PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+    DWORD w = PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+
+    if (p == NULL || end < p) return FALSE;
+    while (p < end) {
+        if (VirtualQuery(p, &m, sizeof(m)) == 0) return FALSE;
+        if (m.State != MEM_COMMIT || (m.Protect & (PAGE_GUARD | PAGE_NOACCESS)) || !(m.Protect & (write ? w : r))) return FALSE;
+        p = (const uint8_t*)m.BaseAddress + m.RegionSize;
+    }
     return TRUE;
 }
+
+#else
+
+#ifndef __USE_GNU
+#define __USE_GNU
+#endif
+#include <link.h>
+
+// Interval index of the readable memory mappings of the process, sorted by start address, adjacent mappings with the same access merged
+// Built from /proc/self/maps or, if not available, from the loaded segments of all modules (dl_iterate_phdr)
+// Rebuilt lazily when a lookup fails, at most once per XCP_MEMORY_INDEX_REFRESH_MS
+#define XCP_MAX_MEMORY_REGIONS 1024
+#define XCP_MEMORY_INDEX_REFRESH_MS 100
+
+typedef struct {
+    uintptr_t start;
+    uintptr_t end;
+    BOOL write;
+} tMemoryRegion;
+
+static tMemoryRegion gMemoryRegions[XCP_MAX_MEMORY_REGIONS];
+static uint32_t gMemoryRegionCount = 0;
+static uint64_t gMemoryIndexTime = 0;
+
+static void addMemoryRegion(uintptr_t start, uintptr_t end, BOOL write) {
+    if (gMemoryRegionCount >= XCP_MAX_MEMORY_REGIONS || start >= end) return;
+    gMemoryRegions[gMemoryRegionCount].start = start;
+    gMemoryRegions[gMemoryRegionCount].end = end;
+    gMemoryRegions[gMemoryRegionCount].write = write;
+    gMemoryRegionCount++;
+}
+
+static int addModuleRegions(struct dl_phdr_info* info, size_t size, void* data) {
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr)* ph = &info->dlpi_phdr[i];
+        if (ph->p_type == PT_LOAD && (ph->p_flags & PF_R)) {
+            uintptr_t start = (uintptr_t)(info->dlpi_addr + ph->p_vaddr);
+            addMemoryRegion(start, start + ph->p_memsz, (ph->p_flags & PF_W) != 0);
+        }
+    }
+    (void)size;
+    (void)data;
+    return 0;
+}
+
+static int compareMemoryRegions(const void* a, const void* b) {
+    uintptr_t sa = ((const tMemoryRegion*)a)->start, sb = ((const tMemoryRegion*)b)->start;
+    return sa < sb ? -1 : sa > sb ? 1 : 0;
+}
+
+static void buildMemoryIndex() {
+
+    char line[512];
+    unsigned long start, end;
+    char perms[5];
+    uint32_t i, n;
+
+    gMemoryRegionCount = 0;
+    FILE* f = fopen("/proc/self/maps", "r");
+    if (f != NULL) {
+        while (fgets(line, sizeof(line), f) != NULL) {
+            if (sscanf(line, "%lx-%lx %4s", &start, &end, perms) == 3 && perms[0] == 'r') {
+                addMemoryRegion((uintptr_t)start, (uintptr_t)end, perms[1] == 'w');
+            }
+        }
+        fclose(f);
+    }
+    else {
+        dl_iterate_phdr(addModuleRegions, NULL);
+    }
+
+    // Sort and merge
+    qsort(gMemoryRegions, gMemoryRegionCount, sizeof(tMemoryRegion), compareMemoryRegions);
+    for (i = 1, n = 0; i < gMemoryRegionCount; i++) {
+        if (gMemoryRegions[i].start <= gMemoryRegions[n].end && gMemoryRegions[i].write == gMemoryRegions[n].write) {
+            if (gMemoryRegions[i].end > gMemoryRegions[n].end) gMemoryRegions[n].end = gMemoryRegions[i].end;
+        }
+        else {
+            gMemoryRegions[++n] = gMemoryRegions[i];
+        }
+    }
+    if (gMemoryRegionCount > 0) gMemoryRegionCount = n + 1;
+    gMemoryIndexTime = clockGet64();
+    XCP_DBG_PRINTF3("Memory index rebuilt, %u regions\n", gMemoryRegionCount);
+}
+
+// Binary search for the region containing p
+static BOOL lookupMemoryIndex(uintptr_t p, uintptr_t end, BOOL write) {
+
+    uint32_t lo = 0, hi = gMemoryRegionCount;
+    while (lo < hi) { // First region with start > p
+        uint32_t m = (lo + hi) / 2;
+        if (gMemoryRegions[m].start <= p) lo = m + 1; else hi = m;
+    }
+    if (lo == 0) return FALSE;
+    for (uint32_t i = lo - 1; i < gMemoryRegionCount; i++) { // Range may span adjacent regions with different access
+        const tMemoryRegion* r = &gMemoryRegions[i];
+        if (r->start > p || p >= r->end || (write && !r->write)) return FALSE;
+        if (end <= r->end) return TRUE;
+        p = r->end;
+    }
+    return FALSE;
+}
+
+BOOL ApplXcpCheckMemory(const uint8_t* p, uint32_t size, BOOL write) {
+
+    uintptr_t a = (uintptr_t)p;
+    uintptr_t end = a + (size > 0 ? size : 1);
+    if (p == NULL || end < a) return FALSE;
+    if (lookupMemoryIndex(a, end, write)) return TRUE;
+    if (gMemoryRegionCount > 0 && clockGet64() - gMemoryIndexTime < XCP_MEMORY_INDEX_REFRESH_MS * (uint64_t)CLOCK_TICKS_PER_MS) return FALSE;
+    buildMemoryIndex(); // New mappings since the last build
+    return lookupMemoryIndex(a, end, write);
+}
+
+#endif
+
+#else
+
+BOOL ApplXcpCheckMemory(const uint8_t* p, uint32_t size, BOOL write) {
+    (void)size;
+    (void)write;
+    return p != NULL;
+}
+
 #endif
 
 
@@ -178,11 +319,11 @@ uint8_t* ApplXcpGetPointer(uint8_t addr_ext, uint32_t addr) {
 
     p = ApplXcpGetBaseAddr() + addr;
 #ifdef XCP_ENABLE_CAL_PAGE
-    p = ecuParAddrMapping(p);
+    p = calSegAddrMapping(p);
 #endif
     
 #ifdef XCP_ENABLE_MEMORY_CHECK
-    if (!check(p)) {
+    if (!ApplXcpCheckMemory(p, 1, FALSE)) {
         XCP_DBG_PRINTF_ERROR("ERROR: Illegal address %08X!\n", addr);
         return NULL;
     }
@@ -369,23 +510,74 @@ void ApplXcpInitBaseAddressList()
 
 #if OPTION_ENABLE_CAL_SEGMENT
 
-// segment = 0
+// Segments created with calSegCreate
 // RAM = page 0, FLASH = page 1
 
+uint8_t ApplXcpGetSegmentCount() {
+    return (uint8_t)calSegCount();
+}
+
+BOOL ApplXcpGetSegmentInfo(uint8_t segment, const char** name, uint32_t* addr, uint32_t* size) {
+    if (segment >= calSegCount()) return FALSE;
+    if (name != NULL) *name = calSegGetName(segment);
+    if (addr != NULL) *addr = ApplXcpGetAddr((uint8_t*)calSegGetAddr(segment));
+    if (size != NULL) *size = calSegGetSize(segment);
+    return TRUE;
+}
+
 uint8_t ApplXcpGetCalPage(uint8_t segment, uint8_t mode) {
-    (void)mode;
-    if (segment > 0) return CRC_PAGE_NOT_VALID;
-    return ecuParGetCalPage();
+    if (segment >= calSegCount()) return CRC_PAGE_NOT_VALID;
+    return calSegGetPage(segment, (mode & CAL_PAGE_MODE_XCP) != 0);
 }
 
 uint8_t ApplXcpSetCalPage(uint8_t segment, uint8_t page, uint8_t mode) {
-    if (segment > 0) return CRC_SEGMENT_NOT_VALID;
-    if (page > 1) return CRC_PAGE_NOT_VALID;
-    if ((mode & (CAL_PAGE_MODE_ECU | CAL_PAGE_MODE_XCP)) != (CAL_PAGE_MODE_ECU | CAL_PAGE_MODE_XCP)) return CRC_PAGE_MODE_NOT_VALID;
-    ecuParSetCalPage(page);
+    BOOL ecu = (mode & CAL_PAGE_MODE_ECU) != 0;
+    BOOL xcp = (mode & CAL_PAGE_MODE_XCP) != 0;
+    if (page > CAL_SEG_PAGE_ROM) return CRC_PAGE_NOT_VALID;
+    if (!ecu && !xcp) return CRC_PAGE_MODE_NOT_VALID;
+    if (mode & CAL_PAGE_MODE_ALL) {
+        for (tCalSegIndex i = 0; i < calSegCount(); i++) calSegSetPage(i, page, ecu, xcp);
+        return 0;
+    }
+    if (!calSegSetPage(segment, page, ecu, xcp)) return CRC_SEGMENT_NOT_VALID;
+    return 0;
+}
+
+// Copy into the RAM page, the FLASH page is read only
+uint8_t ApplXcpCopyCalPage(uint8_t srcSegment, uint8_t srcPage, uint8_t dstSegment, uint8_t dstPage) {
+    if (srcSegment >= calSegCount() || dstSegment >= calSegCount()) return CRC_SEGMENT_NOT_VALID;
+    if (srcPage > CAL_SEG_PAGE_ROM || dstPage > CAL_SEG_PAGE_ROM) return CRC_PAGE_NOT_VALID;
+    if (dstPage == CAL_SEG_PAGE_ROM) return CRC_WRITE_PROTECTED;
+    if (!calSegCopyPage(srcSegment, srcPage, dstSegment)) return CRC_SEGMENT_NOT_VALID; // Different size
+    return 0;
+}
+
+// Calibration consistency point, make all modifications visible to the application
+uint8_t ApplXcpPublishCal() {
+    if (!calSegPublish()) return CRC_RESOURCE_TEMPORARY_NOT_ACCESSIBLE; // A task did not release a calibration segment
     return 0;
 }
 
+#ifdef XCP_ENABLE_FREEZE_CAL_PAGE
+
+uint8_t ApplXcpSetSegmentMode(uint8_t segment, uint8_t mode) {
+    if (mode & ~SEGMENT_FLAG_FREEZE) return CRC_OUT_OF_RANGE;
+    if (!calSegSetFreeze(segment, (mode & SEGMENT_FLAG_FREEZE) != 0)) return CRC_SEGMENT_NOT_VALID;
+    return 0;
+}
+
+uint8_t ApplXcpGetSegmentMode(uint8_t segment) {
+    return calSegGetFreeze(segment) ? SEGMENT_FLAG_FREEZE : 0;
+}
+
+// Store the active pages of the segments in freeze mode in the persistent calibration pages file
+uint8_t ApplXcpFreezeCal() {
+    if (!calSegFreeze()) return CRC_RESOURCE_TEMPORARY_NOT_ACCESSIBLE;
+    return 0;
+}
+
+#endif
+
 #endif
 
 
@@ -466,3 +658,79 @@ BOOL ApplXcpReadA2L(uint8_t size, uint32_t addr, uint8_t* data) {
 
 
 
+#ifdef XCP_ENABLE_DAQ_RESUME
+
+/**************************************************************************/
+// Persistent DAQ configuration
+/**************************************************************************/
+
+// Persistent DAQ configuration file of the selected server, APP_NAME.daq for server 0, APP_NAME_<server>.daq for the others
+static void getDaqConfigFileName(char* name, size_t size, const char* ext) {
+    uint8_t server = XcpGetServer();
+    if (server == 0) {
+        SNPRINTF(name, size, "%s%s", APP_NAME, ext);
+    }
+    else {
+        SNPRINTF(name, size, "%s_%u%s", APP_NAME, server, ext);
+    }
+}
+
+// Write to a temporary file and rename, a power loss never leaves a partially written DAQ configuration
+BOOL ApplXcpStoreDaqConfig(const tXcpDaqConfig* config, const uint8_t* tables) {
+
+    char name[256], tmpName[256];
+    getDaqConfigFileName(name, sizeof(name), ".daq");
+    getDaqConfigFileName(tmpName, sizeof(tmpName), ".daq.tmp");
+    FILE* f = fopen(tmpName, "wb");
+    if (f == NULL) return FALSE;
+    BOOL ok = fwrite(config, sizeof(tXcpDaqConfig), 1, f) == 1 && fwrite(tables, 1, config->size, f) == config->size;
+    if (fclose(f) != 0) ok = FALSE;
+    if (ok) {
+#ifdef _WIN
+        remove(name); // rename does not replace an existing file
+#endif
+        ok = rename(tmpName, name) == 0;
+    }
+    if (!ok) {
+        XCP_DBG_PRINTF_ERROR("ERROR: could not write %s!\n", name);
+        remove(tmpName);
+    }
+    return ok;
+}
+
+BOOL ApplXcpLoadDaqConfig(tXcpDaqConfig* config, uint8_t* tables) {
+
+    char name[256];
+    getDaqConfigFileName(name, sizeof(name), ".daq");
+    FILE* f = fopen(name, "rb");
+    if (f == NULL) return FALSE;
+    uint32_t size = tables != NULL ? config->size : 0;
+    BOOL ok = fread(config, sizeof(tXcpDaqConfig), 1, f) == 1 && (tables == NULL || (config->size == size && fread(tables, 1, size, f) == size));
+    fclose(f);
+    return ok;
+}
+
+void ApplXcpClearDaqConfig() {
+    char name[256];
+    getDaqConfigFileName(name, sizeof(name), ".daq");
+    remove(name);
+}
+
+// FNV-1a hash of the A2L file, the A2L file contains the EPK and all addresses used by the DAQ configuration
+uint32_t ApplXcpGetEpkHash() {
+
+    uint8_t buf[1024];
+    size_t n;
+    uint32_t h = 2166136261UL;
+
+    FILE* f = fopen(OPTION_A2L_FILE_NAME, "rb");
+    if (f == NULL) return 0;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        for (size_t i = 0; i < n; i++) h = (h ^ buf[i]) * 16777619UL;
+    }
+    fclose(f);
+    return h != 0 ? h : 1; // 0 indicates no A2L file
+}
+
+#endif
+
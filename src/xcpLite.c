@@ -11,8 +11,9 @@
 |
 |  Supported commands:
 |   GET_COMM_MODE_INFO GET_ID GET_VERSION
-|   SET_MTA UPLOAD SHORT_UPLOAD DOWNLOAD SHORT_DOWNLOAD
-|   GET_CAL_PAGE SET_CAL_PAGE BUILD_CHECKSUM
+|   SET_MTA UPLOAD SHORT_UPLOAD DOWNLOAD DOWNLOAD_NEXT SHORT_DOWNLOAD
+|   GET_CAL_PAGE SET_CAL_PAGE COPY_CAL_PAGE BUILD_CHECKSUM
+|   GET_PAG_PROCESSOR_INFO GET_SEGMENT_INFO GET_PAGE_INFO SET_SEGMENT_MODE GET_SEGMENT_MODE
 |   GET_DAQ_RESOLUTION_INFO GET_DAQ_PROCESSOR_INFO GET_DAQ_EVENT_INFO GET_DAQ_LIST_INFO
 |   FREE_DAQ ALLOC_DAQ ALLOC_ODT ALLOC_ODT_ENTRY SET_DAQ_PTR WRITE_DAQ WRITE_DAQ_MULTIPLE
 |   GET_DAQ_LIST_MODE SET_DAQ_LIST_MODE START_STOP_SYNCH START_STOP_DAQ_LIST
@@ -28,9 +29,8 @@
 |     - Fixed DAQ+ODT 2 byte DTO header
 |     - Fixed 32 bit time stamp
 |     - Only dynamic DAQ list allocation supported
-|     - Resume is not supported
+|     - Resume mode only with XCP_ENABLE_DAQ_RESUME, resume DAQ lists are started on CONNECT
 |     - Overload indication by event is not supported
-|     - DAQ does not support prescaler
 |     - ODT optimization not supported
 |     - Seed & key is not supported
 |     - Flash programming is not supported
@@ -109,11 +109,56 @@
 #error "Please define XCP_DAQ_MEM_SIZE"
 #endif
 
+// DAQ memory arena, XCP_DAQ_MEM_SIZE is the reserved address space, memory is committed on demand
+// Tables are cache line aligned in the arena
+#ifdef XCP_ENABLE_DAQ_ARENA
+#ifndef XCP_DAQ_ARENA_GRANULARITY
+#define XCP_DAQ_ARENA_GRANULARITY (64*1024) // Commit granularity, multiple of the page size
+#endif
+#define XCP_DAQ_ALIGN(n) (((n) + 63UL) & ~63UL)
+#else
+#define XCP_DAQ_ALIGN(n) (((n) + 3UL) & ~3UL) // tXcpOdt and the ODT entry tables contain 32 bit fields
+#endif
+
+// On change mode is configured per event
+#if defined(XCP_ENABLE_DAQ_ON_CHANGE) && !defined(XCP_ENABLE_DAQ_EVENT_LIST)
+#error "XCP_ENABLE_DAQ_ON_CHANGE requires XCP_ENABLE_DAQ_EVENT_LIST!"
+#endif
+
+// Consistent sampling with sequence counters
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+#ifndef XCP_MAX_SEQLOCK
+#define XCP_MAX_SEQLOCK 32 // Maximum number of regions, each ODT holds a 32 bit region mask
+#endif
+#if XCP_MAX_SEQLOCK > 32
+#error "XCP_MAX_SEQLOCK must be <= 32"
+#endif
+#ifndef XCP_SEQLOCK_RETRIES
+#define XCP_SEQLOCK_RETRIES 8 // Maximum number of retries of an ODT copy, before a torn sample is sent
+#endif
+#endif
+
+// Features which need DAQ list preparation when DAQ is started
+#if defined(XCP_ENABLE_DAQ_ON_CHANGE) || defined(XCP_ENABLE_PACKED_MODE) || defined(XCP_ENABLE_DAQ_SEQLOCK) || defined(XCP_ENABLE_DAQ_STIM)
+#define XCP_DAQ_PREPARE
+#endif
+
 // Dynamic addressing (ext=1, addr=(event<<16)|offset requires transport layer mode XCPTL_QUEUED_CRM
 #if defined(XCP_ENABLE_DYN_ADDRESSING) && !defined(XCPTL_QUEUED_CRM)
 #error "Dynamic address format (ext=1) requires XCPTL_QUEUED_CRM!"
 #endif
 
+// Pending command queue for commands executed asynchronously in the context of an event (dynamic addressing) or in the worker thread
+#if defined(XCP_ENABLE_DYN_ADDRESSING) || defined(XCP_ENABLE_ASYNC_CMD)
+#define XCP_CMD_QUEUE
+#ifndef XCP_CMD_QUEUE_SIZE
+#define XCP_CMD_QUEUE_SIZE 4
+#endif
+#endif
+#if defined(XCP_ENABLE_ASYNC_CMD) && !defined(XCPTL_QUEUED_CRM)
+#error "XCP_ENABLE_ASYNC_CMD requires XCPTL_QUEUED_CRM!"
+#endif
+
 
 /****************************************************************************/
 /* DAQ Type Definition                                                      */
@@ -123,9 +168,21 @@
 /* ODT */
 /* Size must be even !!! */
 typedef struct {
-    uint16_t firstOdtEntry;       /* Absolute odt entry number */
-    uint16_t lastOdtEntry;        /* Absolute odt entry number */
-    uint16_t size;                /* Number of bytes */
+    uint32_t firstOdtEntry;       /* Absolute odt entry number */
+    uint32_t lastOdtEntry;        /* Absolute odt entry number */
+    uint16_t size;                /* Number of bytes of one sample */
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+    uint32_t shadow;              /* Offset of the shadow copy in DAQ memory */
+#endif
+#ifdef XCP_ENABLE_PACKED_MODE
+    uint32_t staging;             /* Offset of the packed mode staging buffer in DAQ memory */
+#endif
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+    uint32_t seqLockMask;         /* Sequence counter protected regions sampled by this ODT */
+#endif
+#ifdef XCP_ENABLE_DAQ_STIM
+    uint32_t stim;                /* Offset of the ODT data in a STIM set */
+#endif
 } tXcpOdt;
 
 
@@ -136,9 +193,26 @@ typedef struct {
     uint16_t eventChannel;
 #ifdef XCP_ENABLE_PACKED_MODE
     uint16_t sampleCount;         /* Packed mode */
+    uint16_t sampleIndex;         /* Packed mode, number of samples in the staging buffers */
 #endif
     uint8_t flags;
     uint8_t priority;
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+    uint8_t prescaler;            /* Event cycles per sample, 0 and 1 = every cycle */
+    uint8_t cycle;                /* Prescaler counter */
+#endif
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+    uint16_t keepAlive;           /* On change mode keep alive cycles, 0 = off */
+    uint16_t changeCycle;         /* Keep alive counter, 0 = send all ODTs */
+#endif
+#ifdef XCP_ENABLE_DAQ_STIM
+    uint32_t stim;                /* Offset of the 3 STIM set buffers in DAQ memory */
+    uint32_t stimSize;            /* Size of a STIM set */
+    uint32_t stimMailbox;         /* Index of the mailbox buffer, STIM_FRESH if not yet applied, shared by receive thread and event */
+    uint8_t stimBack;             /* Index of the buffer, the receive thread writes to */
+    uint8_t stimFront;            /* Index of the buffer, the event applies */
+    uint8_t stimOdt;              /* Next expected relative ODT number */
+#endif
 } tXcpDaqList;
 
 
@@ -146,11 +220,19 @@ typedef struct {
 typedef struct {
     uint16_t         DaqCount;
     uint16_t         OdtCount;       /* Absolute */
-    uint16_t         OdtEntryCount;  /* Absolute */
+    uint32_t         OdtEntryCount;  /* Absolute */
+#ifdef XCP_ENABLE_DAQ_ARENA
+    uint32_t         MemSize;        /* Committed arena size */
+    union {
+        uint8_t*       b;
+        tXcpDaqList*   DaqList;
+    } u;
+#else
     union {
         uint8_t        b[XCP_DAQ_MEM_SIZE];
         tXcpDaqList   DaqList[XCP_DAQ_MEM_SIZE / sizeof(tXcpDaqList)];
     } u;
+#endif
 } tXcpDaq;
 
 
@@ -164,6 +246,18 @@ typedef struct {
 #define DaqListOdtLastEntry(j)  (gXcp.pOdt[j].lastOdtEntry)
 #define DaqListOdtFirstEntry(j) (gXcp.pOdt[j].firstOdtEntry)
 #define DaqListOdtSize(j)       (gXcp.pOdt[j].size)
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+#define DaqListOdtShadow(j)     (&gXcp.Daq.u.b[gXcp.pOdt[j].shadow])
+#endif
+#ifdef XCP_ENABLE_PACKED_MODE
+#define DaqListOdtStaging(j)    (&gXcp.Daq.u.b[gXcp.pOdt[j].staging])
+#endif
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+#define DaqListOdtSeqLockMask(j) (gXcp.pOdt[j].seqLockMask)
+#endif
+#ifdef XCP_ENABLE_DAQ_STIM
+#define DaqListOdtStim(j)       (gXcp.pOdt[j].stim)
+#endif
 
 /* n is absolute odtEntry number */
 #define OdtEntrySize(n)         (gXcp.pOdtEntrySize[n])
@@ -178,6 +272,34 @@ typedef struct {
 #define DaqListPriority(i)      gXcp.Daq.u.DaqList[i].priority
 #ifdef XCP_ENABLE_PACKED_MODE
 #define DaqListSampleCount(i)   gXcp.Daq.u.DaqList[i].sampleCount
+#define DaqListSampleIndex(i)   gXcp.Daq.u.DaqList[i].sampleIndex
+#endif
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+#define DaqListPrescaler(i)     gXcp.Daq.u.DaqList[i].prescaler
+#define DaqListCycle(i)         gXcp.Daq.u.DaqList[i].cycle
+#endif
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+#define DaqListKeepAlive(i)     gXcp.Daq.u.DaqList[i].keepAlive
+#define DaqListChangeCycle(i)   gXcp.Daq.u.DaqList[i].changeCycle
+#endif
+#ifdef XCP_ENABLE_DAQ_STIM
+#define DaqListStimSize(i)      gXcp.Daq.u.DaqList[i].stimSize
+#define DaqListStimMailbox(i)   gXcp.Daq.u.DaqList[i].stimMailbox
+#define DaqListStimBack(i)      gXcp.Daq.u.DaqList[i].stimBack
+#define DaqListStimFront(i)     gXcp.Daq.u.DaqList[i].stimFront
+#define DaqListStimOdt(i)       gXcp.Daq.u.DaqList[i].stimOdt
+#define DaqListStimBuffer(i,n)  (&gXcp.Daq.u.b[gXcp.Daq.u.DaqList[i].stim + (n) * gXcp.Daq.u.DaqList[i].stimSize])
+#define STIM_FRESH              0x80000000UL
+#endif
+
+
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+/* Sequence counter protected memory region */
+typedef struct {
+    uint32_t addr;                /* XCP address */
+    uint32_t size;
+    tXcpSeqLock* lock;
+} tXcpSeqLockRegion;
 #endif
 
 
@@ -192,6 +314,46 @@ typedef union {
     uint32_t dw[((XCPTL_MAX_CTO_SIZE + 3) & 0xFFC) / 4];
 } tXcpCto;
 
+#ifdef XCP_CMD_QUEUE
+
+#define XCP_CMD_CONTEXT_NONE   0xFFFF
+#define XCP_CMD_CONTEXT_WORKER 0xFFFE // XcpWorker
+#define XCP_CMD_CONTEXT_ANY    0xFFFD // Queued behind a pending command, executed in the context which empties the queue
+
+typedef struct {
+    uint16_t context;   // Execution context, event number or XCP_CMD_CONTEXT_xxx
+    uint8_t deferred;   // Command returned CRC_CMD_PENDING, continue in this context
+    uint8_t len;
+    tXcpCto cro;
+} tXcpCmdQueueEntry;
+
+#endif
+
+#ifdef XCP_ENABLE_POLL_LIST
+// Polling list, a precompiled list of variables uploaded with a single USER_CMD
+typedef struct {
+    uint8_t* ptr;               // Pointer, validated when the entry was added
+    uint32_t addr;              // XCP address, the pointer is remapped if it is in a calibration segment
+    uint8_t size;
+} tXcpPollEntry;
+
+typedef struct {
+    uint8_t count;              // Number of entries
+    uint8_t size;               // Sum of the entry sizes, size of the response data
+    tXcpPollEntry entry[XCP_MAX_POLL_ENTRIES];
+} tXcpPollList;
+#endif
+
+#ifdef XCP_ENABLE_DYN_ADDRESSING
+// Live instance of a dynamically addressed object, registered with XcpRegisterInstance
+typedef struct {
+    uint8_t* volatile base;     // Instance address, NULL if not registered
+    uint32_t size;
+    uint8_t mode;               // XCP_INSTANCE_DIRECT or XCP_INSTANCE_CONSISTENT
+    volatile uint32_t refs;     // Number of accesses in progress, XcpUnregisterInstance waits until 0
+} tXcpInstance;
+#endif
+
 
 /****************************************************************************/
 /* Protocol layer data                                                      */
@@ -210,6 +372,31 @@ typedef struct {
     uint32_t MtaAddr;
     uint8_t MtaExt;
 
+#ifdef XCP_ENABLE_BLOCK_MODE
+    uint8_t DownloadRemaining;                 /* Bytes expected in the following DOWNLOAD_NEXT of a master block */
+#endif
+#ifdef XCP_ENABLE_CAL_PAGE
+    BOOL CalSeq;                               /* Calibration sequence (USER_CMD) open, publish at its end */
+#endif
+#ifdef XCP_ENABLE_POLL_LIST
+    tXcpPollList PollList[XCP_MAX_POLL_LISTS]; /* Polling lists by id (USER_CMD) */
+#endif
+
+#ifdef XCP_CMD_QUEUE
+    /* Pending commands, the command at the head of the queue owns Cro, Crm and Mta while SS_CMD_PENDING is set */
+    MUTEX CmdQueueMutex;
+    tXcpCmdQueueEntry CmdQueue[XCP_CMD_QUEUE_SIZE];
+    uint16_t CmdQueueHead;
+    uint16_t CmdQueueCount;
+    BOOL CmdExecuting;                         /* Head of the queue is being executed */
+    BOOL CmdDeferred;                          /* Executing command is a continuation after CRC_CMD_PENDING */
+    uint16_t CmdContext;                       /* Execution context requested with CRC_CMD_PENDING */
+#endif
+
+#ifdef XCP_ENABLE_DYN_ADDRESSING
+    tXcpInstance Instance[XCP_MAX_EVENT];      /* Live instances by event number */
+#endif
+
     /* Dynamic DAQ list structures, This structure should be stored in resume mode */
     tXcpDaq Daq;
     tXcpOdt* pOdt;
@@ -218,9 +405,22 @@ typedef struct {
 
     uint64_t DaqStartClock64;
     uint32_t DaqOverflowCount;
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+    uint32_t DaqTornCount;                 /* ODTs sent inconsistent after XCP_SEQLOCK_RETRIES */
+    uint16_t SeqLockCount;
+    tXcpSeqLockRegion SeqLock[XCP_MAX_SEQLOCK];
+#endif
+#ifdef XCP_ENABLE_DAQ_STIM
+    uint32_t StimOverrunCount;             /* STIM sets overwritten before applied by the event */
+#endif
+#ifdef XCP_ENABLE_DAQ_RESUME
+    BOOL DaqConfigLoaded;                  /* DAQ tables loaded from the persistent DAQ configuration */
+    uint16_t DaqConfigId;                  /* Session configuration id of the persistent DAQ configuration */
+    uint32_t DaqConfigEpkHash;
+#endif
 
     /* State info from SET_DAQ_PTR for WRITE_DAQ and WRITE_DAQ_MULTIPLE */
-    uint16_t WriteDaqOdtEntry;
+    uint32_t WriteDaqOdtEntry;
     uint16_t WriteDaqOdt;
     uint16_t WriteDaqDaq;
 
@@ -253,7 +453,49 @@ typedef struct {
 } tXcpData;
 
 
+#if XCP_MAX_SERVERS > 1
+// Independent server instances, the instance is selected per thread with XcpSelectServer
+static tXcpData gXcpServers[XCP_MAX_SERVERS];
+THREAD_LOCAL uint8_t gXcpSelectedServer = 0;
+#define gXcp (gXcpServers[gXcpSelectedServer])
+
+// Commands of all server instances are serialized
+// They share the calibration segments, the memory regions and the application callbacks, which are not thread safe
+static MUTEX gXcpCmdMutex;
+static BOOL gXcpCmdMutexInit = FALSE;
+static void XcpProcessCommand_();
+static void XcpProcessCommand() {
+    mutexLock(&gXcpCmdMutex);
+    XcpProcessCommand_();
+    mutexUnlock(&gXcpCmdMutex);
+}
+// Release the lock while a command calculates or waits without accessing shared state, the other servers continue meanwhile
+#define XcpCmdUnlock() mutexUnlock(&gXcpCmdMutex)
+#define XcpCmdLock() mutexLock(&gXcpCmdMutex)
+#else
+#define XcpProcessCommand_ XcpProcessCommand
+#define XcpCmdUnlock()
+#define XcpCmdLock()
 static tXcpData gXcp = { 0,0,0 };
+#endif
+
+// Select the server instance for all following XCP calls of the calling thread
+void XcpSelectServer(uint8_t server) {
+#if XCP_MAX_SERVERS > 1
+    assert(server < XCP_MAX_SERVERS);
+    gXcpSelectedServer = server;
+#else
+    (void)server;
+#endif
+}
+
+uint8_t XcpGetServer() {
+#if XCP_MAX_SERVERS > 1
+    return gXcpSelectedServer;
+#else
+    return 0;
+#endif
+}
 
 #define CRM                       (gXcp.Crm)
 #define CRM_LEN                   (gXcp.CrmLen)
@@ -274,7 +516,7 @@ static tXcpData gXcp = { 0,0,0 };
 
 #define error(e) { err=(e); goto negative_response; }
 #define check_error(e) { err=(e); if (err!=0) goto negative_response;  }
-#ifdef XCP_ENABLE_DYN_ADDRESSING
+#ifdef XCP_CMD_QUEUE
 #define check_result(e) { err=(e); if (err!=0) { if (err==CRC_CMD_PENDING) { XcpPushCommand(); goto no_response;} else goto negative_response; } }
 #else
 #define check_result(e) { err=(e); if (err!=0) goto negative_response; }
@@ -284,6 +526,16 @@ static tXcpData gXcp = { 0,0,0 };
 #define isConnected() (gXcp.SessionStatus & SS_CONNECTED)
 #define isDaqRunning() (gXcp.SessionStatus & SS_DAQ)
 #define isCmdPending() (gXcp.SessionStatus & SS_CMD_PENDING)
+#ifdef XCP_ENABLE_ASYNC_CMD
+#define isAnyContext(c,context) ((c) == XCP_CMD_CONTEXT_ANY && (context) == XCP_CMD_CONTEXT_WORKER) // Not in application event threads
+#else
+#define isAnyContext(c,context) ((c) == XCP_CMD_CONTEXT_ANY)
+#endif
+#ifdef XCP_CMD_QUEUE
+#define isCmdDeferred() (gXcp.CmdDeferred)
+#else
+#define isCmdDeferred() FALSE
+#endif
 #define isLegacyMode() (gXcp.SessionStatus & SS_LEGACY_MODE)
 
 
@@ -341,31 +593,304 @@ uint32_t XcpGetDaqOverflowCount() {
     return gXcp.DaqOverflowCount;
 }
 
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+uint32_t XcpGetDaqTornCount() {
+    return gXcp.DaqTornCount;
+}
+#endif
+
+#ifdef XCP_ENABLE_DAQ_STIM
+uint32_t XcpGetStimOverrunCount() {
+    return gXcp.StimOverrunCount;
+}
+#endif
+
+
+
+/****************************************************************************/
+/* Pending command queue                                                    */
+/****************************************************************************/
+
+#ifdef XCP_CMD_QUEUE
+
+static void XcpProcessCommand();
+
+// Request asynchronous execution of the current command in another context
+static uint8_t XcpDeferCommand(uint16_t context) {
+    gXcp.CmdContext = context;
+    return CRC_CMD_PENDING;
+}
+
+// Push the current command, which returned CRC_CMD_PENDING, to the queue
+// Commands already executing from the queue stay at its head, XcpExecuteCommands moves them to the new context
+static void XcpPushCommand() {
+    if (gXcp.CmdExecuting) return;
+    mutexLock(&gXcp.CmdQueueMutex);
+    tXcpCmdQueueEntry* e = &gXcp.CmdQueue[gXcp.CmdQueueHead]; // Queue is empty, if the command is not executed from the queue
+    e->context = gXcp.CmdContext;
+    e->deferred = TRUE;
+    e->len = gXcp.CroLen;
+    memcpy(&e->cro, &gXcp.Cro, gXcp.CroLen);
+    gXcp.CmdQueueCount = 1;
+    gXcp.SessionStatus |= (uint16_t)SS_CMD_PENDING;
+    mutexUnlock(&gXcp.CmdQueueMutex);
+}
+
+// Handle a command received while commands are pending
+// GET_STATUS is answered immediately, CONNECT, DISCONNECT and SYNCH cancel the queue, all other commands are queued
+// Returns FALSE, if the command has to be processed normally
+static BOOL XcpQueueCommand(const uint8_t* cro, uint16_t len) {
+
+    uint8_t crm[CRM_GET_STATUS_LEN];
+
+    if (cro[0] == CC_GET_STATUS) {
+        crm[0] = PID_RES;
+        crm[1] = (uint8_t)(gXcp.SessionStatus & 0xFF);
+        crm[2] = 0;
+        crm[3] = 0; // STATE_NUMBER
+#ifdef XCP_ENABLE_DAQ_RESUME
+        crm[4] = (uint8_t)gXcp.DaqConfigId; crm[5] = (uint8_t)(gXcp.DaqConfigId >> 8);
+#else
+        crm[4] = crm[5] = 0;
+#endif
+        XcpTlSendCrm(crm, CRM_GET_STATUS_LEN);
+        return TRUE;
+    }
+
+    mutexLock(&gXcp.CmdQueueMutex);
+    if (gXcp.CmdQueueCount == 0) { // The last pending command completed meanwhile
+        mutexUnlock(&gXcp.CmdQueueMutex);
+        return FALSE;
+    }
+    if (cro[0] == CC_CONNECT || cro[0] == CC_DISCONNECT || cro[0] == CC_SYNC) {
+        if (!gXcp.CmdExecuting) {
+            XCP_DBG_PRINTF1("%u pending commands canceled!\n", gXcp.CmdQueueCount);
+            gXcp.CmdQueueCount = 0;
+            gXcp.SessionStatus &= (uint16_t)~SS_CMD_PENDING;
+            mutexUnlock(&gXcp.CmdQueueMutex);
+            return FALSE;
+        }
+    }
+    else if (gXcp.CmdQueueCount < XCP_CMD_QUEUE_SIZE) {
+        tXcpCmdQueueEntry* e = &gXcp.CmdQueue[(gXcp.CmdQueueHead + gXcp.CmdQueueCount) % XCP_CMD_QUEUE_SIZE];
+        e->context = XCP_CMD_CONTEXT_ANY;
+        e->deferred = FALSE;
+        e->len = (uint8_t)len;
+        memcpy(&e->cro, cro, len);
+        gXcp.CmdQueueCount++;
+        mutexUnlock(&gXcp.CmdQueueMutex);
+        return TRUE;
+    }
+    mutexUnlock(&gXcp.CmdQueueMutex);
+
+    crm[0] = PID_ERR;
+    crm[1] = CRC_CMD_BUSY;
+    XcpTlSendCrm(crm, 2);
+    return TRUE;
+}
+
+// Execute the pending commands for this context, until the queue is empty or the head of the queue requires another context
+// Only one context executes from the queue at a time, commands queued behind a pending command are executed by the worker, if there is one
+// base is the address base of an event context (dynamic addressing)
+// Returns TRUE, if a command was executed
+static BOOL XcpExecuteCommands(uint16_t context, uint8_t* base) {
+
+    BOOL executed = FALSE;
+    tXcpCmdQueueEntry* e;
+
+    for (;;) {
+
+        mutexLock(&gXcp.CmdQueueMutex);
+        e = &gXcp.CmdQueue[gXcp.CmdQueueHead];
+        if (gXcp.CmdQueueCount == 0 || gXcp.CmdExecuting || (e->context != context && !isAnyContext(e->context, context))) {
+            mutexUnlock(&gXcp.CmdQueueMutex);
+            return executed;
+        }
+        gXcp.CmdExecuting = TRUE;
+        mutexUnlock(&gXcp.CmdQueueMutex);
+
+        gXcp.CroLen = e->len;
+        memcpy(&gXcp.Cro, &e->cro, e->len);
+        gXcp.CmdDeferred = e->deferred;
+        gXcp.CmdContext = XCP_CMD_CONTEXT_NONE;
+#ifdef XCP_ENABLE_DYN_ADDRESSING
+        if (e->deferred && gXcp.MtaExt == 1 && context < XCP_CMD_CONTEXT_ANY) { // Convert MtaPtr to context
+            gXcp.MtaPtr = base + (gXcp.MtaAddr & 0xFFFF);
+            gXcp.MtaExt = 0;
+        }
+#else
+        (void)base;
+#endif
+        XcpProcessCommand();
+        executed = TRUE;
+
+        mutexLock(&gXcp.CmdQueueMutex);
+        gXcp.CmdExecuting = FALSE;
+        gXcp.CmdDeferred = FALSE;
+        if (gXcp.CmdContext != XCP_CMD_CONTEXT_NONE) { // Deferred again to another context
+            e->context = gXcp.CmdContext;
+            e->deferred = TRUE;
+        }
+        else {
+            gXcp.CmdQueueHead = (uint16_t)((gXcp.CmdQueueHead + 1) % XCP_CMD_QUEUE_SIZE);
+            if (--gXcp.CmdQueueCount == 0) gXcp.SessionStatus &= (uint16_t)~SS_CMD_PENDING;
+        }
+        mutexUnlock(&gXcp.CmdQueueMutex);
+    }
+}
+
+#endif
+
+#ifdef XCP_ENABLE_ASYNC_CMD
+// Execute pending commands deferred to the worker context, called cyclically by a worker thread
+BOOL XcpWorker() {
+    if (!isCmdPending()) return FALSE;
+    return XcpExecuteCommands(XCP_CMD_CONTEXT_WORKER, NULL);
+}
+#endif
 
 
 /****************************************************************************/
 /* Calibration                                                              */
 /****************************************************************************/
 
+// Copy size bytes from a command buffer to ECU memory and from ECU memory to a command buffer
+// Values of 2, 4 and 8 byte at a naturally aligned ECU address are transferred with a single store or load, to make sure the application never sees a half updated calibration value
+// The command buffer side may be unaligned and is copied to/from a local variable
+static void XcpWriteMem(uint8_t* dst, const uint8_t* src, uint8_t size) {
+
+    if (((uintptr_t)dst & (size - 1)) == 0) {
+        switch (size) {
+        case 2: { uint16_t v; memcpy(&v, src, 2); *(volatile uint16_t*)dst = v; return; }
+        case 4: { uint32_t v; memcpy(&v, src, 4); *(volatile uint32_t*)dst = v; return; }
+        case 8: { uint64_t v; memcpy(&v, src, 8); *(volatile uint64_t*)dst = v; return; }
+        }
+    }
+    memcpy(dst, src, size);
+}
+
+static void XcpReadMem(uint8_t* dst, const uint8_t* src, uint8_t size) {
+
+    if (((uintptr_t)src & (size - 1)) == 0) {
+        switch (size) {
+        case 2: { uint16_t v = *(const volatile uint16_t*)src; memcpy(dst, &v, 2); return; }
+        case 4: { uint32_t v = *(const volatile uint32_t*)src; memcpy(dst, &v, 4); return; }
+        case 8: { uint64_t v = *(const volatile uint64_t*)src; memcpy(dst, &v, 8); return; }
+        }
+    }
+    memcpy(dst, src, size);
+}
+
+#ifdef XCP_ENABLE_DYN_ADDRESSING
+// Pointer for a direct access to size bytes at offset in the live instance of event, NULL if the access has to be deferred to the event context
+// The instance can not be unregistered until XcpUnlockInstance
+static uint8_t* XcpLockInstance(uint16_t event, uint32_t offset, uint32_t size) {
+
+    if (event >= XCP_MAX_EVENT) return NULL;
+    tXcpInstance* i = &gXcp.Instance[event];
+    if (i->mode != XCP_INSTANCE_DIRECT) return NULL;
+    atomicAdd32(&i->refs, 1); // Increment before the base pointer is checked, XcpUnregisterInstance clears it before it checks the count
+    uint8_t* base = i->base;
+    if (base == NULL || offset + size > i->size) {
+        atomicSub32(&i->refs, 1);
+        return NULL;
+    }
+    return base + offset;
+}
+
+static void XcpUnlockInstance(uint16_t event) {
+    atomicSub32(&gXcp.Instance[event].refs, 1);
+}
+#endif
+
+#ifdef XCP_ENABLE_CAL_PAGE
+// Calibration consistency point, the application publishes the modified calibration pages
+// The working page may change, remap the MTA
+static uint8_t XcpPublishCal() {
+    uint8_t err = ApplXcpPublishCal();
+    if (gXcp.MtaExt == 0x00 && gXcp.MtaPtr != NULL && !isCmdDeferred()) gXcp.MtaPtr = ApplXcpGetPointer(gXcp.MtaExt, gXcp.MtaAddr);
+    return err;
+}
+#endif
+
+#ifdef XCP_ENABLE_POLL_LIST
+// Add n entries (addr,ext,size) to polling list id, the response data of a poll must fit into one CRM
+// All entries are validated before they are added, the list is not modified on error
+static uint8_t XcpAddPollEntries(uint8_t id, uint8_t n, const uint8_t* entries) {
+
+    if (id >= XCP_MAX_POLL_LISTS) return CRC_OUT_OF_RANGE;
+    tXcpPollList* l = &gXcp.PollList[id];
+    if (l->count + n > XCP_MAX_POLL_ENTRIES) return CRC_MEMORY_OVERFLOW;
+    uint32_t total = l->size;
+    for (uint8_t i = 0; i < n; i++, entries += 6) {
+        uint32_t addr;
+        memcpy(&addr, entries, 4);
+        uint8_t ext = entries[4];
+        uint8_t size = entries[5];
+        if (ext != 0x00 || size == 0) return CRC_OUT_OF_RANGE;
+        total += size;
+        if (total > CRM_UPLOAD_MAX_SIZE) return CRC_MEMORY_OVERFLOW;
+        uint8_t* p = ApplXcpGetPointer(ext, addr);
+        if (p == NULL || !ApplXcpCheckMemory(p, size, FALSE)) return CRC_ACCESS_DENIED;
+        tXcpPollEntry* e = &l->entry[l->count + i]; // Not yet part of the list
+        e->ptr = p;
+        e->addr = addr;
+        e->size = size;
+    }
+    l->count = (uint8_t)(l->count + n);
+    l->size = (uint8_t)total;
+    return 0;
+}
+
+static void XcpClearPollLists() {
+    for (uint8_t id = 0; id < XCP_MAX_POLL_LISTS; id++) {
+        gXcp.PollList[id].count = 0;
+        gXcp.PollList[id].size = 0;
+    }
+}
+
+// Read all variables of polling list id into data
+static uint8_t XcpPoll(uint8_t id, uint8_t* data) {
+
+    if (id >= XCP_MAX_POLL_LISTS) return CRC_OUT_OF_RANGE;
+    const tXcpPollList* l = &gXcp.PollList[id];
+    for (uint8_t i = 0; i < l->count; i++) {
+        const tXcpPollEntry* e = &l->entry[i];
+#ifdef XCP_ENABLE_CAL_PAGE
+        uint8_t* p = ApplXcpGetPointer(0x00, e->addr); // The page selected for XCP access may have been switched or published
+        if (p == NULL) return CRC_ACCESS_DENIED;
+#else
+        uint8_t* p = e->ptr;
+#endif
+        XcpReadMem(data, p, e->size);
+        data += e->size;
+    }
+    return 0;
+}
+#endif
+
 // Write n bytes. Copying of size bytes from data to gXcp.MtaPtr
 static uint8_t XcpWriteMta( uint8_t size, const uint8_t* data )
 {
     // Ext=0x01 Relativ addressing
 #ifdef XCP_ENABLE_DYN_ADDRESSING
     if (gXcp.MtaExt == 0x01) {
-        return CRC_CMD_PENDING; // Async command
+        uint16_t event = (uint16_t)(gXcp.MtaAddr >> 16);
+        uint8_t* p = XcpLockInstance(event, gXcp.MtaAddr & 0xFFFF, size);
+        if (p == NULL) return XcpDeferCommand(event); // Async command, execute in the context of the event
+        XcpWriteMem(p, data, size); // Direct write to a live instance
+        XcpUnlockInstance(event);
+        gXcp.MtaAddr += size;
+        return 0;
     }
 #endif
 
     // Ext=0x00 Standard memory access
     if (gXcp.MtaExt == 0x00) {
-        if (gXcp.MtaPtr == NULL) return CRC_ACCESS_DENIED;
-        while (size > 0) {
-            *gXcp.MtaPtr = *data;
-            gXcp.MtaPtr++;
-            data++;
-            size--;
-        }
+        if (gXcp.MtaPtr == NULL || !ApplXcpCheckMemory(gXcp.MtaPtr, size, TRUE)) return CRC_ACCESS_DENIED;
+        XcpWriteMem(gXcp.MtaPtr, data, size);
+        gXcp.MtaPtr += size;
+        gXcp.MtaAddr += size;
         return 0; // Ok
     }
 
@@ -378,7 +903,13 @@ static uint8_t XcpReadMta( uint8_t size, uint8_t* data )
     // Ext=0x01 Relativ addressing
 #ifdef XCP_ENABLE_DYN_ADDRESSING
     if (gXcp.MtaExt == 0x01) {
-        return CRC_CMD_PENDING; // Async command
+        uint16_t event = (uint16_t)(gXcp.MtaAddr >> 16);
+        uint8_t* p = XcpLockInstance(event, gXcp.MtaAddr & 0xFFFF, size);
+        if (p == NULL) return XcpDeferCommand(event); // Async command, execute in the context of the event
+        XcpReadMem(data, p, size); // Direct read from a live instance
+        XcpUnlockInstance(event);
+        gXcp.MtaAddr += size;
+        return 0;
     }
 #endif
 
@@ -393,19 +924,167 @@ static uint8_t XcpReadMta( uint8_t size, uint8_t* data )
 
     // Ext=0x00 Standard memory access
     if (gXcp.MtaExt == 0x00) {
-        if (gXcp.MtaPtr == NULL) return CRC_ACCESS_DENIED;
-        while (size > 0) {
-            *data = *gXcp.MtaPtr;
-            data++;
-            gXcp.MtaPtr++;
-            size--;
-        }
+        if (gXcp.MtaPtr == NULL || !ApplXcpCheckMemory(gXcp.MtaPtr, size, FALSE)) return CRC_ACCESS_DENIED;
+        XcpReadMem(data, gXcp.MtaPtr, size);
+        gXcp.MtaPtr += size;
+        gXcp.MtaAddr += size;
         return 0; // Ok
     }
 
     return CRC_ACCESS_DENIED; // Access violation
 }
 
+#ifdef XCP_ENABLE_CHECKSUM
+
+// Checksum calculation for BUILD_CHECKSUM, type selected by XCP_CHECKSUM_TYPE
+// CRC32 (IEEE 802.3, AUTOSAR CRC32) uses the ARMv8 CRC32 instructions if available, slice-by-8 tables otherwise
+// CRC16 (CRC-16/ARC) and CRC16CCITT (AUTOSAR CRC16, CRC-16/CCITT-FALSE) use a byte table
+
+#define XCP_CHECKSUM_BLOCK_SIZE (64*1024) // Block size for incremental calculation
+#define XCP_CHECKSUM_PENDING_MS 50 // Send EV_CMD_PENDING to restart the master timeout, if calculation takes longer
+
+#if XCP_CHECKSUM_TYPE == XCP_CHECKSUM_TYPE_CRC32 && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define XCP_CHECKSUM_INIT 0xFFFFFFFF
+#define XCP_CHECKSUM_FINAL(s) ((s) ^ 0xFFFFFFFF)
+static void XcpInitChecksum() {}
+static uint32_t XcpUpdateChecksum(uint32_t crc, const uint8_t* p, uint32_t n) {
+    while (n > 0 && ((uintptr_t)p & 7) != 0) { crc = __crc32b(crc, *p++); n--; }
+    for (; n >= 8; n -= 8, p += 8) crc = __crc32d(crc, *(const uint64_t*)p);
+    while (n > 0) { crc = __crc32b(crc, *p++); n--; }
+    return crc;
+}
+
+#elif XCP_CHECKSUM_TYPE == XCP_CHECKSUM_TYPE_CRC32
+#define XCP_CHECKSUM_INIT 0xFFFFFFFF
+#define XCP_CHECKSUM_FINAL(s) ((s) ^ 0xFFFFFFFF)
+static uint32_t gCrcTable[8][256];
+static void XcpInitChecksum() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : (c >> 1);
+        gCrcTable[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) gCrcTable[t][i] = (gCrcTable[t - 1][i] >> 8) ^ gCrcTable[0][gCrcTable[t - 1][i] & 0xFF];
+    }
+}
+static uint32_t XcpUpdateChecksum(uint32_t crc, const uint8_t* p, uint32_t n) {
+    uint32_t a, b;
+    while (n > 0 && ((uintptr_t)p & 7) != 0) { crc = (crc >> 8) ^ gCrcTable[0][(crc ^ *p++) & 0xFF]; n--; }
+    for (; n >= 8; n -= 8, p += 8) { // Slice-by-8 tables require little endian words
+#ifdef XCP_CPUTYPE_BIGENDIAN
+        a = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+        b = (uint32_t)p[4] | ((uint32_t)p[5] << 8) | ((uint32_t)p[6] << 16) | ((uint32_t)p[7] << 24);
+#else
+        memcpy(&a, p, 4);
+        memcpy(&b, p + 4, 4);
+#endif
+        a ^= crc;
+        crc = gCrcTable[7][a & 0xFF] ^ gCrcTable[6][(a >> 8) & 0xFF] ^ gCrcTable[5][(a >> 16) & 0xFF] ^ gCrcTable[4][a >> 24] ^
+              gCrcTable[3][b & 0xFF] ^ gCrcTable[2][(b >> 8) & 0xFF] ^ gCrcTable[1][(b >> 16) & 0xFF] ^ gCrcTable[0][b >> 24];
+    }
+    while (n > 0) { crc = (crc >> 8) ^ gCrcTable[0][(crc ^ *p++) & 0xFF]; n--; }
+    return crc;
+}
+
+#elif XCP_CHECKSUM_TYPE == XCP_CHECKSUM_TYPE_CRC16
+#define XCP_CHECKSUM_INIT 0x0000
+#define XCP_CHECKSUM_FINAL(s) (s)
+static uint16_t gCrcTable[256];
+static void XcpInitChecksum() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint16_t c = (uint16_t)i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? (uint16_t)((c >> 1) ^ 0xA001) : (uint16_t)(c >> 1);
+        gCrcTable[i] = c;
+    }
+}
+static uint32_t XcpUpdateChecksum(uint32_t crc, const uint8_t* p, uint32_t n) {
+    while (n > 0) { crc = (crc >> 8) ^ gCrcTable[(crc ^ *p++) & 0xFF]; n--; }
+    return crc;
+}
+
+#elif XCP_CHECKSUM_TYPE == XCP_CHECKSUM_TYPE_CRC16CCITT
+#define XCP_CHECKSUM_INIT 0xFFFF
+#define XCP_CHECKSUM_FINAL(s) (s)
+static uint16_t gCrcTable[256];
+static void XcpInitChecksum() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint16_t c = (uint16_t)(i << 8);
+        for (int k = 0; k < 8; k++) c = (c & 0x8000) ? (uint16_t)((c << 1) ^ 0x1021) : (uint16_t)(c << 1);
+        gCrcTable[i] = c;
+    }
+}
+static uint32_t XcpUpdateChecksum(uint32_t crc, const uint8_t* p, uint32_t n) {
+    while (n > 0) { crc = ((crc << 8) & 0xFFFF) ^ gCrcTable[((crc >> 8) ^ *p++) & 0xFF]; n--; }
+    return crc;
+}
+
+#else // XCP_CHECKSUM_TYPE_ADD44
+#define XCP_CHECKSUM_INIT 0
+#define XCP_CHECKSUM_FINAL(s) (s)
+static void XcpInitChecksum() {}
+static uint32_t XcpUpdateChecksum(uint32_t s, const uint8_t* p, uint32_t n) {
+    uint32_t d;
+    for (; n >= 4; n -= 4, p += 4) { memcpy(&d, p, 4); s += d; }
+    return s;
+}
+#endif
+
+// Calculate the checksum over n bytes at MTA, MTA is post incremented
+// Large ranges are calculated blockwise, EV_CMD_PENDING keeps the master waiting
+// With XCP_ENABLE_ASYNC_CMD, ranges larger than one block are deferred to the worker thread
+static uint8_t XcpBuildChecksum(uint32_t n, uint32_t* result) {
+
+    uint32_t s = XCP_CHECKSUM_INIT;
+    uint64_t t = clockGet64();
+    uint8_t err;
+
+#ifdef XCP_ENABLE_ASYNC_CMD
+    if (n > XCP_CHECKSUM_BLOCK_SIZE && !isCmdDeferred()) return XcpDeferCommand(XCP_CMD_CONTEXT_WORKER);
+    uint32_t total = n;
+#endif
+
+#if XCP_CHECKSUM_TYPE == XCP_CHECKSUM_TYPE_ADD44
+    if (n % 4 != 0) return CRC_OUT_OF_RANGE;
+#endif
+    if (gXcp.MtaExt == 0x00) { // Standard memory access, calculate in place
+        if (gXcp.MtaPtr == NULL || !ApplXcpCheckMemory(gXcp.MtaPtr, n, FALSE)) return CRC_ACCESS_DENIED;
+        XcpCmdUnlock(); // Memory access checked, the calculation does not access shared state
+        while (n > 0) {
+            uint32_t k = n > XCP_CHECKSUM_BLOCK_SIZE ? XCP_CHECKSUM_BLOCK_SIZE : n;
+            s = XcpUpdateChecksum(s, gXcp.MtaPtr, k);
+            gXcp.MtaPtr += k;
+            gXcp.MtaAddr += k;
+            n -= k;
+            if (n > 0 && clockGet64() - t > XCP_CHECKSUM_PENDING_MS * (uint64_t)CLOCK_TICKS_PER_MS) {
+#ifdef XCP_ENABLE_ASYNC_CMD
+                uint8_t progress = (uint8_t)(((uint64_t)(total - n) * 100) / total); // Progress in percent as event data
+                XcpSendEvent(EVC_CMD_PENDING, &progress, 1);
+#else
+                XcpSendEvent(EVC_CMD_PENDING, NULL, 0);
+#endif
+                t = clockGet64();
+            }
+        }
+        XcpCmdLock();
+    }
+    else { // Other address extensions, read through the MTA
+        uint8_t b[240];
+        while (n > 0) {
+            uint8_t k = (uint8_t)(n > sizeof(b) ? sizeof(b) : n);
+            err = XcpReadMta(k, b);
+            if (err != 0) return err == CRC_CMD_PENDING ? CRC_ACCESS_DENIED : err;
+            s = XcpUpdateChecksum(s, b, k);
+            n -= k;
+        }
+    }
+    *result = XCP_CHECKSUM_FINAL(s);
+    return 0;
+}
+
+#endif
+
 
 
 /****************************************************************************/
@@ -415,7 +1094,10 @@ static uint8_t XcpReadMta( uint8_t size, uint8_t* data )
 // Free all dynamic DAQ lists
 static void  XcpFreeDaq( void )
 {
-  gXcp.SessionStatus &= (uint16_t)(~SS_DAQ);
+  gXcp.SessionStatus &= (uint16_t)(~(SS_DAQ|SS_RESUME));
+#ifdef XCP_ENABLE_DAQ_RESUME
+  gXcp.DaqConfigLoaded = FALSE;
+#endif
 
   gXcp.Daq.DaqCount = 0;
   gXcp.Daq.OdtCount = 0;
@@ -425,25 +1107,49 @@ static void  XcpFreeDaq( void )
   gXcp.pOdtEntryAddr = 0;
   gXcp.pOdtEntrySize = 0;
 
+#ifdef XCP_ENABLE_DAQ_ARENA
+  if (gXcp.Daq.MemSize > 0) memset(gXcp.Daq.u.b, 0, gXcp.Daq.MemSize);
+#else
   memset((uint8_t*)&gXcp.Daq.u.b[0], 0, XCP_DAQ_MEM_SIZE);
+#endif
+}
+
+// Check s bytes of DAQ memory are available
+// Arena: commit and prefault more memory in the command thread, XcpEvent never causes allocations or page faults
+static uint8_t XcpCheckDaqMemory( uint32_t s )
+{
+  if (s >= XCP_DAQ_MEM_SIZE) return CRC_MEMORY_OVERFLOW;
+#ifdef XCP_ENABLE_DAQ_ARENA
+  if (gXcp.Daq.u.b == NULL) return CRC_MEMORY_OVERFLOW; // Reservation failed
+  if (s > gXcp.Daq.MemSize) {
+    uint32_t n = (s + XCP_DAQ_ARENA_GRANULARITY - 1) & ~(uint32_t)(XCP_DAQ_ARENA_GRANULARITY - 1);
+    if (n > XCP_DAQ_MEM_SIZE) n = XCP_DAQ_MEM_SIZE;
+    if (!memoryCommit(gXcp.Daq.u.b, n)) return CRC_MEMORY_OVERFLOW;
+    memset(gXcp.Daq.u.b + gXcp.Daq.MemSize, 0, n - gXcp.Daq.MemSize);
+    XCP_DBG_PRINTF3("DAQ memory arena grown to %u KiB\n", n / 1024);
+    gXcp.Daq.MemSize = n;
+  }
+#endif
+  return 0;
 }
 
 // Allocate Memory for daq,odt,odtEntries and Queue according to DaqCount, OdtCount and OdtEntryCount
+// Structure of arrays: DAQ lists, ODTs, ODT entry addresses, ODT entry sizes
 static uint8_t  XcpAllocMemory( void )
 {
-  uint32_t s;
+  uint32_t s, odt, addr, size;
 
   /* Check memory overflow */
-  s = ( gXcp.Daq.DaqCount * (uint32_t)sizeof(tXcpDaqList ) +
-      ( gXcp.Daq.OdtCount * (uint32_t)sizeof(tXcpOdt) ) +
-      ( gXcp.Daq.OdtEntryCount * ((uint32_t)sizeof(uint8_t*) + (uint32_t)sizeof(uint8_t) ) ) );
+  odt = XCP_DAQ_ALIGN(gXcp.Daq.DaqCount * (uint32_t)sizeof(tXcpDaqList));
+  addr = odt + XCP_DAQ_ALIGN(gXcp.Daq.OdtCount * (uint32_t)sizeof(tXcpOdt));
+  size = addr + XCP_DAQ_ALIGN(gXcp.Daq.OdtEntryCount * (uint32_t)sizeof(uint32_t));
+  s = size + gXcp.Daq.OdtEntryCount * (uint32_t)sizeof(uint8_t);
+  if (XcpCheckDaqMemory(s) != 0) return CRC_MEMORY_OVERFLOW;
 
-  if (s>=XCP_DAQ_MEM_SIZE) return CRC_MEMORY_OVERFLOW;
+  gXcp.pOdt = (tXcpOdt*)&gXcp.Daq.u.b[odt];
+  gXcp.pOdtEntryAddr = (uint32_t*)&gXcp.Daq.u.b[addr];
+  gXcp.pOdtEntrySize = (uint8_t*)&gXcp.Daq.u.b[size];
 
-  gXcp.pOdt = (tXcpOdt*)&gXcp.Daq.u.DaqList[gXcp.Daq.DaqCount];
-  gXcp.pOdtEntryAddr = (uint32_t*)&gXcp.pOdt[gXcp.Daq.OdtCount];
-  gXcp.pOdtEntrySize = (uint8_t*)&gXcp.pOdtEntryAddr[gXcp.Daq.OdtEntryCount];
-  
   XCP_DBG_PRINTF4("[XcpAllocMemory] %u of %u Bytes used\n",s,XCP_DAQ_MEM_SIZE );
   return 0;
 }
@@ -454,11 +1160,15 @@ static uint8_t  XcpAllocDaq( uint16_t daqCount )
   if ( (gXcp.Daq.OdtCount!=0) || (gXcp.Daq.OdtEntryCount!=0) )  {
     return CRC_SEQUENCE;
   }
-  if( daqCount == 0 || daqCount>255)  {
+#if XCP_MAX_DAQ < 0xFFFF
+  if( daqCount == 0 || daqCount>XCP_MAX_DAQ)  {
+#else
+  if( daqCount == 0 )  {
+#endif
     return CRC_OUT_OF_RANGE;
   }
 
-  gXcp.Daq.DaqCount = (uint8_t)daqCount;
+  gXcp.Daq.DaqCount = daqCount;
   return XcpAllocMemory();
 }
 
@@ -475,7 +1185,7 @@ static uint8_t XcpAllocOdt( uint16_t daq, uint8_t odtCount )
   }
 
   n = (uint32_t)gXcp.Daq.OdtCount + (uint32_t)odtCount;
-  if (n > 0xFFFF) return CRC_OUT_OF_RANGE; // Overall number of ODTs limited to 64K
+  if (n > XCP_MAX_ODT) return CRC_OUT_OF_RANGE; // Overall number of ODTs limited to 64K or by the PID range
 
   gXcp.Daq.u.DaqList[daq].firstOdt = gXcp.Daq.OdtCount;
   gXcp.Daq.OdtCount = (uint16_t)n;
@@ -485,18 +1195,6 @@ static uint8_t XcpAllocOdt( uint16_t daq, uint8_t odtCount )
   return XcpAllocMemory();
 }
 
-// Adjust ODT size by size
-static void  XcpAdjustOdtSize(uint16_t daq, uint16_t odt, uint8_t size) {
-#ifdef XCP_ENABLE_PACKED_MODE
-    uint16_t sc = DaqListSampleCount(daq);
-    if (sc == 0) sc = 1;
-    DaqListOdtSize(odt) = (uint16_t)(DaqListOdtSize(odt) + size*sc);
-#else
-    (void) daq;
-    DaqListOdtSize(odt) = (uint16_t)(DaqListOdtSize(odt) + size);
-#endif
-}
-
 // Allocate all ODT entries, Parameter odt is relative odt number
 static uint8_t XcpAllocOdtEntry( uint16_t daq, uint8_t odt, uint8_t odtEntryCount )
 {
@@ -510,14 +1208,13 @@ static uint8_t XcpAllocOdtEntry( uint16_t daq, uint8_t odt, uint8_t odtEntryCoun
     return (uint8_t)CRC_OUT_OF_RANGE;
   }
 
-  /* Absolute ODT entry count is limited to 64K */
-  n = (uint32_t)gXcp.Daq.OdtEntryCount + (uint32_t)odtEntryCount;
-  if (n>0xFFFF) return CRC_MEMORY_OVERFLOW;
+  /* Absolute ODT entry count is limited by DAQ memory only */
+  n = gXcp.Daq.OdtEntryCount + (uint32_t)odtEntryCount;
 
   xcpFirstOdt = gXcp.Daq.u.DaqList[daq].firstOdt;
   gXcp.pOdt[xcpFirstOdt+odt].firstOdtEntry = gXcp.Daq.OdtEntryCount;
-  gXcp.Daq.OdtEntryCount = (uint16_t)n;
-  gXcp.pOdt[xcpFirstOdt + odt].lastOdtEntry = (uint16_t)(gXcp.Daq.OdtEntryCount - 1);
+  gXcp.Daq.OdtEntryCount = n;
+  gXcp.pOdt[xcpFirstOdt + odt].lastOdtEntry = gXcp.Daq.OdtEntryCount - 1;
   gXcp.pOdt[xcpFirstOdt + odt].size = 0;
 
   return XcpAllocMemory();
@@ -529,7 +1226,7 @@ static uint8_t  XcpSetDaqPtr(uint16_t daq, uint8_t odt, uint8_t idx) {
     uint16_t odt0 = (uint16_t)(DaqListFirstOdt(daq) + odt); // Absolute odt index
     if ((daq >= gXcp.Daq.DaqCount) || (odt >= DaqListOdtCount(daq)) || (idx >= DaqListOdtEntryCount(odt0))) return CRC_OUT_OF_RANGE;
     // Save info for XcpAddOdtEntry from WRITE_DAQ and WRITE_DAQ_MULTIPLE
-    gXcp.WriteDaqOdtEntry = (uint16_t)(DaqListOdtFirstEntry(odt0) + idx); // Absolute odt entry index
+    gXcp.WriteDaqOdtEntry = DaqListOdtFirstEntry(odt0) + idx; // Absolute odt entry index
     gXcp.WriteDaqOdt = odt0; // Absolute odt index
     gXcp.WriteDaqDaq = daq;
     return 0;
@@ -551,20 +1248,20 @@ static uint8_t XcpAddOdtEntry(uint32_t addr, uint8_t ext, uint8_t size) {
         DaqListEventChannel(gXcp.WriteDaqDaq) = e1;
      }
     else {
-        if (NULL == ApplXcpGetPointer(ext, addr)) return CRC_ACCESS_DENIED; // Access denied 
+        if (!ApplXcpCheckMemory(ApplXcpGetPointer(ext, addr), size, FALSE)) return CRC_ACCESS_DENIED; // Access denied
     }
 #else
-    if (NULL == ApplXcpGetPointer(ext, addr)) return CRC_ACCESS_DENIED; // Access denied 
+    if (!ApplXcpCheckMemory(ApplXcpGetPointer(ext, addr), size, FALSE)) return CRC_ACCESS_DENIED; // Access denied
 #endif
     OdtEntrySize(gXcp.WriteDaqOdtEntry) = size;
     OdtEntryAddr(gXcp.WriteDaqOdtEntry) = addr; // Holds A2L/XCP address
-    XcpAdjustOdtSize(gXcp.WriteDaqDaq, gXcp.WriteDaqOdt, size);
+    DaqListOdtSize(gXcp.WriteDaqOdt) = (uint16_t)(DaqListOdtSize(gXcp.WriteDaqOdt) + size);
     gXcp.WriteDaqOdtEntry++; // Autoincrement to next ODT entry, no autoincrementing over ODTs
     return 0;
 }
 
 // Set DAQ list mode
-static uint8_t XcpSetDaqListMode(uint16_t daq, uint16_t event, uint8_t mode, uint8_t prio ) {
+static uint8_t XcpSetDaqListMode(uint16_t daq, uint16_t event, uint8_t mode, uint8_t prio, uint8_t prescaler ) {
 
 #ifdef XCP_ENABLE_DAQ_EVENT_LIST
     tXcpEvent* e = XcpGetEvent(event); // Check if event exists
@@ -577,13 +1274,121 @@ static uint8_t XcpSetDaqListMode(uint16_t daq, uint16_t event, uint8_t mode, uin
     DaqListEventChannel(daq) = event;
     DaqListFlags(daq) = mode;
     DaqListPriority(daq) = prio;
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+    DaqListPrescaler(daq) = prescaler;
+#else
+    (void)prescaler;
+#endif
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+    DaqListKeepAlive(daq) = e->keepAlive;
+#endif
   return 0;
 }
 
+#ifdef XCP_DAQ_PREPARE
+// Prepare the DAQ lists for start, lists already running are not modified
+// Allocate the on change shadow copies and the packed mode staging buffers behind the DAQ tables
+// Reset the keep alive counters to send all ODTs on the first event, reset the packed mode sample index
+// Find the sequence counter protected regions sampled by each ODT
+// Allocate the STIM set buffers and initialize the STIM mailboxes of not running STIM lists
+static uint8_t XcpPrepareDaqLists( void )
+{
+  uint32_t s;
+  uint16_t daq, odt;
+
+  if (gXcp.Daq.DaqCount == 0 || gXcp.Daq.OdtCount == 0) return 0;
+  s = (uint32_t)((uint8_t*)&gXcp.pOdtEntrySize[gXcp.Daq.OdtEntryCount] - &gXcp.Daq.u.b[0]);
+  for (daq = 0; daq < gXcp.Daq.DaqCount; daq++) {
+    // Lists already running are used by the event threads, their state is kept, only their memory is accounted for
+    BOOL running = (DaqListFlags(daq) & DAQ_FLAG_RUNNING) != 0;
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+    for (odt = DaqListFirstOdt(daq); odt <= DaqListLastOdt(daq) && !running; odt++) {
+      uint32_t e, mask = 0;
+      for (e = DaqListOdtFirstEntry(odt); e <= DaqListOdtLastEntry(odt) && OdtEntrySize(e) != 0; e++) {
+        for (uint16_t i = 0; i < gXcp.SeqLockCount; i++) {
+          if (OdtEntryAddr(e) < gXcp.SeqLock[i].addr + gXcp.SeqLock[i].size && gXcp.SeqLock[i].addr < OdtEntryAddr(e) + OdtEntrySize(e)) mask |= (1UL << i);
+        }
+      }
+      DaqListOdtSeqLockMask(odt) = mask;
+    }
+#endif
+#ifdef XCP_ENABLE_DAQ_STIM
+    if (DaqListFlags(daq) & DAQ_FLAG_DIRECTION) {
+      if (!running) {
+        uint32_t n = 0;
+        for (odt = DaqListFirstOdt(daq); odt <= DaqListLastOdt(daq); odt++) {
+          if (DaqListOdtSize(odt) + XCP_DAQ_HDR_SIZE + 4 > XCPTL_MAX_DTO_SIZE) return CRC_DAQ_CONFIG; // STIM ODT does not fit into a DTO
+          DaqListOdtStim(odt) = n;
+          n += DaqListOdtSize(odt);
+        }
+        gXcp.Daq.u.DaqList[daq].stim = s;
+        DaqListStimSize(daq) = n;
+        DaqListStimBack(daq) = 0;
+        DaqListStimMailbox(daq) = 1;
+        DaqListStimFront(daq) = 2;
+        DaqListStimOdt(daq) = 0;
+      }
+      s = gXcp.Daq.u.DaqList[daq].stim + 3 * DaqListStimSize(daq);
+      continue; // Packed and on change mode are not supported for STIM lists
+    }
+#endif
+#ifdef XCP_ENABLE_PACKED_MODE
+    uint16_t sc = DaqListSampleCount(daq);
+    if (sc > 1) {
+      if (!running) {
+        DaqListSampleIndex(daq) = 0;
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+        DaqListKeepAlive(daq) = 0; // On change mode is not supported for packed DAQ lists
+#endif
+      }
+      for (odt = DaqListFirstOdt(daq); odt <= DaqListLastOdt(daq); odt++) {
+        if ((uint32_t)DaqListOdtSize(odt) * sc + XCP_DAQ_HDR_SIZE + 4 > XCPTL_MAX_DTO_SIZE) return CRC_DAQ_CONFIG; // Packed ODT does not fit into a DTO
+        if (!running) gXcp.pOdt[odt].staging = s;
+        s += (uint32_t)DaqListOdtSize(odt) * sc;
+      }
+    }
+#endif
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+    if (DaqListKeepAlive(daq) != 0) {
+      if (!running) DaqListChangeCycle(daq) = 0;
+      for (odt = DaqListFirstOdt(daq); odt <= DaqListLastOdt(daq); odt++) {
+        if (!running) gXcp.pOdt[odt].shadow = s;
+        s += DaqListOdtSize(odt);
+      }
+    }
+#endif
+  }
+  if (XcpCheckDaqMemory(s) != 0) return CRC_MEMORY_OVERFLOW;
+  XCP_DBG_PRINTF4("[XcpPrepareDaqLists] %u of %u Bytes used\n", s, XCP_DAQ_MEM_SIZE);
+  return 0;
+}
+#endif
+
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+// Check if the data of an ODT differs from its shadow copy
+static BOOL XcpOdtChanged( uint32_t odt, const uint8_t* base )
+{
+  const uint8_t* s = DaqListOdtShadow(odt);
+  uint32_t e, el, n;
+
+  el = DaqListOdtLastEntry(odt);
+  for (e = DaqListOdtFirstEntry(odt); e <= el; e++) {
+    n = OdtEntrySize(e);
+    if (n == 0) break;
+    if (memcmp(s, &base[OdtEntryAddr(e)], n) != 0) return TRUE;
+    s += n;
+  }
+  return FALSE;
+}
+#endif
+
 // Start DAQ list
 // Start event processing
 static void XcpStartDaq( uint16_t daq )
 {
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+  DaqListCycle(daq) = (uint8_t)(DaqListPrescaler(daq) - 1); // Sample on the first event
+#endif
   DaqListFlags(daq) |= DAQ_FLAG_RUNNING;
   gXcp.SessionStatus |= SS_DAQ;
 }
@@ -596,6 +1401,12 @@ static void XcpStartAllSelectedDaq()
   
   gXcp.DaqStartClock64 = ApplXcpGetClock64();
   gXcp.DaqOverflowCount = 0;
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+  gXcp.DaqTornCount = 0;
+#endif
+#ifdef XCP_ENABLE_DAQ_STIM
+  gXcp.StimOverrunCount = 0;
+#endif
 
   // Reset event time stamps
 #ifdef XCP_ENABLE_DAQ_EVENT_LIST
@@ -609,6 +1420,9 @@ static void XcpStartAllSelectedDaq()
   // Start all selected DAQs
   for (daq=0;daq<gXcp.Daq.DaqCount;daq++)  {
     if ( (DaqListFlags(daq) & DAQ_FLAG_SELECTED) != 0 ) {
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+      DaqListCycle(daq) = (uint8_t)(DaqListPrescaler(daq) - 1); // Sample on the first event
+#endif
       DaqListFlags(daq) |= DAQ_FLAG_RUNNING;
       DaqListFlags(daq) &= (uint8_t)~DAQ_FLAG_SELECTED;
 #ifdef XCP_ENABLE_DEBUG_PRINTS
@@ -626,7 +1440,7 @@ static void XcpStartAllSelectedDaq()
 // Returns TRUE if all DAQ lists are stopped and event procession has stopped
 static uint8_t XcpStopDaq( uint16_t daq )
 {
-  DaqListFlags(daq) &= (uint8_t)(DAQ_FLAG_DIRECTION|DAQ_FLAG_TIMESTAMP|DAQ_FLAG_NO_PID);
+  DaqListFlags(daq) &= (uint8_t)(DAQ_FLAG_DIRECTION|DAQ_FLAG_TIMESTAMP|DAQ_FLAG_NO_PID|DAQ_FLAG_RESUME);
 
   /* Check if all DAQ lists are stopped */
   for (daq=0; daq<gXcp.Daq.DaqCount; daq++)  {
@@ -655,26 +1469,321 @@ static void XcpStopAllSelectedDaq()
 // Stop all DAQs
 static void XcpStopAllDaq( void )
 {
-  for (uint8_t daq=0; daq<gXcp.Daq.DaqCount; daq++) {
-    DaqListFlags(daq) &= (uint8_t)(DAQ_FLAG_DIRECTION|DAQ_FLAG_TIMESTAMP|DAQ_FLAG_NO_PID);
+  for (uint16_t daq=0; daq<gXcp.Daq.DaqCount; daq++) {
+    DaqListFlags(daq) &= (uint8_t)(DAQ_FLAG_DIRECTION|DAQ_FLAG_TIMESTAMP|DAQ_FLAG_NO_PID|DAQ_FLAG_RESUME);
   }
   gXcp.SessionStatus &= (uint16_t)(~SS_DAQ); // Stop processing DAQ events
 }
 
 
+/****************************************************************************/
+/* Persistent DAQ configuration and resume mode                             */
+/****************************************************************************/
+
+#ifdef XCP_ENABLE_DAQ_RESUME
+
+#define XCP_DAQ_CONFIG_MAGIC 0x44504358UL // "XCPD"
+#define XCP_DAQ_CONFIG_LAYOUT ((uint32_t)sizeof(tXcpDaqList) | ((uint32_t)sizeof(tXcpOdt) << 8) | ((uint32_t)XCP_DAQ_HDR_TYPE << 16) | ((uint32_t)XCP_DAQ_ALIGN(1) << 24))
+
+// Size of the DAQ tables (DAQ lists, ODTs, ODT entry addresses and sizes) at the begin of the DAQ memory
+#define XcpDaqTableSize() ((uint32_t)(gXcp.pOdtEntrySize - gXcp.Daq.u.b) + gXcp.Daq.OdtEntryCount)
+
+// Store the DAQ tables as one binary blob
+// The DAQ tables are not modified, DAQ may be running
+static uint8_t XcpStoreDaqConfig( uint16_t configId, uint8_t mode )
+{
+  tXcpDaqConfig c;
+
+  if ((0 == gXcp.Daq.DaqCount) || (0 == gXcp.Daq.OdtCount) || (0 == gXcp.Daq.OdtEntryCount)) return CRC_DAQ_CONFIG;
+  c.magic = XCP_DAQ_CONFIG_MAGIC;
+  c.layout = XCP_DAQ_CONFIG_LAYOUT;
+  c.epkHash = ApplXcpGetEpkHash();
+  if (c.epkHash == 0) return CRC_RESOURCE_TEMPORARY_NOT_ACCESSIBLE; // The DAQ configuration could never be resumed
+  c.size = XcpDaqTableSize();
+  c.odtEntryCount = gXcp.Daq.OdtEntryCount;
+  c.daqCount = gXcp.Daq.DaqCount;
+  c.odtCount = gXcp.Daq.OdtCount;
+  c.configId = configId;
+  c.mode = mode;
+  if (!ApplXcpStoreDaqConfig(&c, gXcp.Daq.u.b)) return CRC_RESOURCE_TEMPORARY_NOT_ACCESSIBLE;
+  gXcp.DaqConfigId = configId;
+  XCP_DBG_PRINTF1("Persistent DAQ configuration stored, configId=%u, size=%u, resume=%u\n", configId, c.size, (mode & SET_REQUEST_STORE_DAQ_REQ_RESUME) != 0);
+  return 0;
+}
+
+// Check the consistency of loaded DAQ tables
+static BOOL XcpCheckDaqTables( void )
+{
+  uint16_t daq, odt;
+  uint32_t e, size;
+
+  for (daq = 0; daq < gXcp.Daq.DaqCount; daq++) {
+    if (DaqListFirstOdt(daq) > DaqListLastOdt(daq) || DaqListLastOdt(daq) >= gXcp.Daq.OdtCount) return FALSE;
+  }
+  for (odt = 0; odt < gXcp.Daq.OdtCount; odt++) {
+    if (DaqListOdtFirstEntry(odt) > DaqListOdtLastEntry(odt) || DaqListOdtLastEntry(odt) >= gXcp.Daq.OdtEntryCount) return FALSE;
+    size = 0;
+    for (e = DaqListOdtFirstEntry(odt); e <= DaqListOdtLastEntry(odt); e++) {
+      if (OdtEntrySize(e) > XCP_MAX_ODT_ENTRY_SIZE) return FALSE;
+      size += OdtEntrySize(e);
+    }
+    if (size != DaqListOdtSize(odt)) return FALSE;
+  }
+  return TRUE;
+}
+
+// Load the persistent DAQ configuration, called by XcpStart
+// The DAQ lists in resume mode are started when the XCP client connects
+static void XcpLoadDaqConfig( void )
+{
+  tXcpDaqConfig c;
+  uint16_t daq;
+
+  if (!ApplXcpLoadDaqConfig(&c, NULL)) return; // No persistent DAQ configuration
+  if (c.magic != XCP_DAQ_CONFIG_MAGIC || c.layout != XCP_DAQ_CONFIG_LAYOUT || c.daqCount == 0 || c.odtCount < c.daqCount || c.odtEntryCount < c.odtCount
+#if XCP_MAX_DAQ < 0xFFFF
+    || c.daqCount > XCP_MAX_DAQ
+#endif
+#if XCP_MAX_ODT < 0xFFFF
+    || c.odtCount > XCP_MAX_ODT
+#endif
+    ) {
+    XCP_DBG_PRINT_ERROR("ERROR: incompatible persistent DAQ configuration ignored!\n");
+    return;
+  }
+  gXcp.Daq.DaqCount = c.daqCount;
+  gXcp.Daq.OdtCount = c.odtCount;
+  gXcp.Daq.OdtEntryCount = c.odtEntryCount;
+  if (XcpAllocMemory() != 0 || c.size != XcpDaqTableSize() || !ApplXcpLoadDaqConfig(&c, gXcp.Daq.u.b) || !XcpCheckDaqTables()) {
+    XCP_DBG_PRINT_ERROR("ERROR: invalid persistent DAQ configuration ignored!\n");
+    XcpFreeDaq();
+    return;
+  }
+
+  // Reset the DAQ list states, keep the DAQ list modes
+  for (daq = 0; daq < gXcp.Daq.DaqCount; daq++) {
+    DaqListFlags(daq) &= (uint8_t)(DAQ_FLAG_DIRECTION|DAQ_FLAG_TIMESTAMP|DAQ_FLAG_NO_PID|DAQ_FLAG_RESUME);
+    if (!(c.mode & SET_REQUEST_STORE_DAQ_REQ_RESUME)) DaqListFlags(daq) &= (uint8_t)~DAQ_FLAG_RESUME;
+    if (DaqListFlags(daq) & DAQ_FLAG_RESUME) gXcp.SessionStatus |= SS_RESUME;
+  }
+  gXcp.DaqConfigLoaded = TRUE;
+  gXcp.DaqConfigId = c.configId;
+  gXcp.DaqConfigEpkHash = c.epkHash;
+  XCP_DBG_PRINTF1("Persistent DAQ configuration loaded, configId=%u, daqCount=%u, odtCount=%u, odtEntryCount=%u, resume=%u\n", c.configId, c.daqCount, c.odtCount, c.odtEntryCount, (gXcp.SessionStatus & SS_RESUME) != 0);
+}
+
+// Check the loaded DAQ configuration matches the application, when the XCP client connects
+// The A2L file and the events are created after XcpStart
+static BOOL XcpCheckDaqConfig( void )
+{
+  if (!gXcp.DaqConfigLoaded) return FALSE;
+  uint32_t epkHash = ApplXcpGetEpkHash();
+  if (epkHash == 0 || gXcp.DaqConfigEpkHash != epkHash) { // 0 indicates the EPK hash is not available
+    XCP_DBG_PRINT_ERROR("ERROR: persistent DAQ configuration does not match the EPK!\n");
+    return FALSE;
+  }
+  for (uint16_t daq = 0; daq < gXcp.Daq.DaqCount; daq++) {
+#ifdef XCP_ENABLE_DAQ_EVENT_LIST
+    if (XcpGetEvent(DaqListEventChannel(daq)) == NULL) {
+      XCP_DBG_PRINTF_ERROR("ERROR: event %u of the persistent DAQ configuration does not exist!\n", DaqListEventChannel(daq));
+      return FALSE;
+    }
+#endif
+    // Check the memory access of all ODT entries, as WRITE_DAQ does
+    for (uint16_t odt = DaqListFirstOdt(daq); odt <= DaqListLastOdt(daq); odt++) {
+      for (uint32_t e = DaqListOdtFirstEntry(odt); e <= DaqListOdtLastEntry(odt); e++) {
+        BOOL ok;
+#ifdef XCP_ENABLE_DYN_ADDRESSING
+        uint16_t event = DaqListEventChannel(daq);
+        if (event < XCP_MAX_EVENT && gXcp.Instance[event].base != NULL) { // Entries relative to a registered instance
+          ok = OdtEntryAddr(e) + OdtEntrySize(e) <= gXcp.Instance[event].size;
+        }
+        else
+#endif
+        {
+          ok = ApplXcpCheckMemory(ApplXcpGetPointer(0x00, OdtEntryAddr(e)), OdtEntrySize(e), FALSE);
+        }
+        if (!ok) {
+          XCP_DBG_PRINTF_ERROR("ERROR: ODT entry %08X,%u of the persistent DAQ configuration is not accessible!\n", OdtEntryAddr(e), OdtEntrySize(e));
+          return FALSE;
+        }
+      }
+    }
+  }
+  return TRUE;
+}
+
+// Start all DAQ lists in resume mode, after the CONNECT response has been sent
+static void XcpResumeDaq( void )
+{
+  uint8_t ev[6];
+  uint32_t t;
+
+#ifdef XCP_DAQ_PREPARE
+  if (XcpPrepareDaqLists() != 0) return;
+#endif
+  if (!ApplXcpStartDaq()) return;
+  for (uint16_t daq = 0; daq < gXcp.Daq.DaqCount; daq++) {
+    if (DaqListFlags(daq) & DAQ_FLAG_RESUME) DaqListFlags(daq) |= DAQ_FLAG_SELECTED;
+  }
+
+  // EV_RESUME_MODE with session configuration id and current timestamp
+  t = (uint32_t)ApplXcpGetClock64();
+  memcpy(&ev[0], &gXcp.DaqConfigId, 2);
+  memcpy(&ev[2], &t, 4);
+  XcpSendEvent(EVC_RESUME_MODE, ev, 6);
+
+  XcpStartAllSelectedDaq();
+  XCP_DBG_PRINTF1("DAQ resumed, configId=%u\n", gXcp.DaqConfigId);
+}
+
+#endif // XCP_ENABLE_DAQ_RESUME
+
+
 /****************************************************************************/
 /* Data Aquisition Processor                                                */
 /****************************************************************************/
 
+// Copy the data of an ODT
+static void XcpCopyOdt(uint8_t* d, uint32_t odt, const uint8_t* base)
+{
+    uint32_t e, el, n;
+
+    /* This is the inner loop, optimize here */
+    e = DaqListOdtFirstEntry(odt);
+    if (OdtEntrySize(e) != 0) {
+        el = DaqListOdtLastEntry(odt);
+        while (e <= el) { // inner DAQ loop
+            n = OdtEntrySize(e);
+            if (n == 0) break;
+            memcpy(d, &base[OdtEntryAddr(e)], n);
+            d += n;
+            e++;
+        } // ODT entry
+    }
+}
+
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+
+// Sum of the sequence counters of all regions in mask, 1 if a writer is active
+static uint32_t XcpSeqLockRead(uint32_t mask)
+{
+    uint32_t i, v, s = 0;
+
+    for (i = 0; mask != 0; i++, mask >>= 1) {
+        if ((mask & 1) == 0) continue;
+        v = atomicLoad32(gXcp.SeqLock[i].lock);
+        if (v & 1) return 1;
+        s += v;
+    }
+    return s & ~1UL;
+}
+
+// Copy the data of an ODT consistent to the sequence counters of the regions it samples
+// Retry the copy, if a writer was active, send a torn sample when the retry budget is exhausted
+static void XcpCopyOdtConsistent(uint8_t* d, uint32_t odt, const uint8_t* base)
+{
+    uint32_t mask = DaqListOdtSeqLockMask(odt);
+    uint32_t s, retry;
+
+    for (retry = 0; ; retry++) {
+        s = XcpSeqLockRead(mask);
+        XcpCopyOdt(d, odt, base);
+        atomicFence();
+        if (s != 1 && s == XcpSeqLockRead(mask)) return;
+        if (retry >= XCP_SEQLOCK_RETRIES) break;
+    }
+    gXcp.DaqTornCount++;
+    XCP_DBG_PRINTF3("WARNING: Torn sample! odt=%u\n", odt);
+}
+
+#endif
+
+#ifdef XCP_ENABLE_DAQ_STIM
+
+// Receive a STIM DTO, called in the receive thread, which is the single producer of all STIM mailboxes
+// Collect the ODTs of a DAQ list, publish the complete set in the mailbox with the last ODT
+static void XcpStim(const uint8_t* p, uint16_t len)
+{
+    uint32_t s;
+    uint16_t daq, odt, hs = XCP_DAQ_HDR_SIZE;
+
+    if (!isDaqRunning()) return;
+    if (len < XCP_DAQ_HDR_SIZE) return;
+    odt = p[0];
+#if XCP_DAQ_HDR_TYPE == DAQ_HDR_PID
+    for (daq = 0; daq < gXcp.Daq.DaqCount; daq++) { // Find the DAQ list of the absolute odt number
+        if (odt >= DaqListFirstOdt(daq) && odt <= DaqListLastOdt(daq)) break;
+    }
+    if (daq >= gXcp.Daq.DaqCount) return;
+    odt = (uint16_t)(odt - DaqListFirstOdt(daq));
+#elif XCP_DAQ_HDR_TYPE == DAQ_HDR_ODT_DAQB
+    daq = p[1];
+#else
+    memcpy(&daq, &p[XCP_DAQ_HDR_SIZE - 2], 2);
+#endif
+    if (daq >= gXcp.Daq.DaqCount) return;
+    if ((DaqListFlags(daq) & (DAQ_FLAG_DIRECTION | DAQ_FLAG_RUNNING)) != (DAQ_FLAG_DIRECTION | DAQ_FLAG_RUNNING)) return; // Not a running STIM list
+    if (odt != DaqListStimOdt(daq)) { // Out of sequence, drop the incomplete set
+        XCP_DBG_PRINTF3("WARNING: STIM out of sequence! daq=%u, odt=%u\n", daq, odt);
+        DaqListStimOdt(daq) = 0;
+        if (odt != 0) return;
+    }
+    if (odt == 0 && (DaqListFlags(daq) & DAQ_FLAG_TIMESTAMP)) hs = XCP_DAQ_HDR_SIZE + 4; // Timestamp is ignored
+    odt = (uint16_t)(odt + DaqListFirstOdt(daq));
+    if (odt > DaqListLastOdt(daq) || len != hs + DaqListOdtSize(odt)) {
+        XCP_DBG_PRINTF_ERROR("ERROR: STIM DTO invalid! daq=%u, len=%u\n", daq, len);
+        DaqListStimOdt(daq) = 0;
+        return;
+    }
+    memcpy(DaqListStimBuffer(daq, DaqListStimBack(daq)) + DaqListOdtStim(odt), &p[hs], DaqListOdtSize(odt));
+    if (odt < DaqListLastOdt(daq)) {
+        DaqListStimOdt(daq)++;
+        return;
+    }
+
+    // Set complete, exchange with the mailbox buffer
+    DaqListStimOdt(daq) = 0;
+    s = atomicExchange32(&DaqListStimMailbox(daq), DaqListStimBack(daq) | STIM_FRESH);
+    if (s & STIM_FRESH) gXcp.StimOverrunCount++; // Previous set not applied by the event
+    DaqListStimBack(daq) = (uint8_t)(s & ~STIM_FRESH);
+}
+
+// Apply the latest complete STIM set of a DAQ list to application memory, called in the event
+static void XcpApplyStim(uint16_t daq, uint8_t* base)
+{
+    uint32_t e, el, n, odt;
+    const uint8_t* d;
+
+    if ((atomicLoad32(&DaqListStimMailbox(daq)) & STIM_FRESH) == 0) return; // No new set
+    DaqListStimFront(daq) = (uint8_t)(atomicExchange32(&DaqListStimMailbox(daq), DaqListStimFront(daq)) & ~STIM_FRESH);
+    d = DaqListStimBuffer(daq, DaqListStimFront(daq));
+    for (odt = DaqListFirstOdt(daq); odt <= DaqListLastOdt(daq); odt++) {
+        el = DaqListOdtLastEntry(odt);
+        for (e = DaqListOdtFirstEntry(odt); e <= el; e++) {
+            n = OdtEntrySize(e);
+            if (n == 0) break;
+            memcpy(&base[OdtEntryAddr(e)], d, n);
+            d += n;
+        }
+    }
+}
+
+#endif
+
 // Measurement data acquisition, sample and transmit measurement date associated to event
 
 static void XcpEvent_(uint16_t event, uint8_t* base, uint64_t clock)
 {
-  uint8_t* d;
   uint8_t* d0;
-  uint32_t e, el, odt, daq, hs, n;
+  uint32_t odt, daq, hs;
 #ifdef XCP_ENABLE_PACKED_MODE
-  uint32_t sc;
+  uint8_t* d;
+  uint32_t e, el, n, sc, i;
+#endif
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+  uint32_t chg; // First changed ODT
+  BOOL cmp; // Send only changed ODTs
 #endif
   void* handle = NULL;
   uint8_t prio = 0;
@@ -696,24 +1805,104 @@ static void XcpEvent_(uint16_t event, uint8_t* base, uint64_t clock)
   for (daq=0; daq<gXcp.Daq.DaqCount; daq++) {
       if ((DaqListFlags(daq) & (uint8_t)DAQ_FLAG_RUNNING) == 0) continue; // DAQ list not active
       if (DaqListEventChannel(daq) != event) continue; // DAQ list not associated with this event
-      if (DaqListPriority(daq) > prio) prio = DaqListPriority(daq);
+#ifdef XCP_ENABLE_DAQ_STIM
+      if (DaqListFlags(daq) & DAQ_FLAG_DIRECTION) { // STIM list
+          XcpApplyStim(daq, base);
+          continue;
+      }
+#endif
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+      if (DaqListPrescaler(daq) > 1) { // Skip this cycle, before any transmit buffer is reserved
+#ifdef XCP_ENABLE_MULTITHREAD_EVENTS
+          mutexLock(&ev->mutex); // The prescaler counter is shared by all threads triggering this event
+#endif
+          BOOL skip = ++DaqListCycle(daq) < DaqListPrescaler(daq);
+          if (!skip) DaqListCycle(daq) = 0;
+#ifdef XCP_ENABLE_MULTITHREAD_EVENTS
+          mutexUnlock(&ev->mutex);
+#endif
+          if (skip) continue;
+      }
+#endif
 #ifdef XCP_ENABLE_PACKED_MODE
+      // Packed mode, collect sc samples of each ODT entry element grouped in the staging buffers
+      // Transmit on the last sample, with the timestamp of the last sample
       sc = DaqListSampleCount(daq); // Packed mode sample count, 0 if not packed
+      if (sc > 1) {
+#ifdef XCP_ENABLE_MULTITHREAD_EVENTS
+          mutexLock(&ev->mutex); // The staging buffers and the sample index are shared by all threads triggering this event, locked until the staging buffers are transmitted
+#endif
+          i = DaqListSampleIndex(daq);
+          for (odt = DaqListFirstOdt(daq); odt <= DaqListLastOdt(daq); odt++) {
+              d = DaqListOdtStaging(odt);
+              el = DaqListOdtLastEntry(odt);
+              for (e = DaqListOdtFirstEntry(odt); e <= el; e++) {
+                  n = OdtEntrySize(e);
+                  if (n == 0) break;
+                  memcpy(d + i * n, &base[OdtEntryAddr(e)], n);
+                  d += n * sc;
+              }
+          }
+          if (++i < sc) {
+              DaqListSampleIndex(daq) = (uint16_t)i;
+#ifdef XCP_ENABLE_MULTITHREAD_EVENTS
+              mutexUnlock(&ev->mutex);
+#endif
+              continue;
+          }
+          DaqListSampleIndex(daq) = 0;
+      }
 #endif
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+      // On change mode, find the first changed ODT, skip the DAQ list if nothing changed
+      // The first ODT is always sent together with any other ODT, because it carries the timestamp
+      chg = DaqListFirstOdt(daq);
+      cmp = FALSE;
+      if (DaqListKeepAlive(daq) != 0) {
+          if (DaqListChangeCycle(daq) != 0) { // Keep alive not expired
+              while (chg <= DaqListLastOdt(daq) && !XcpOdtChanged(chg, base)) chg++;
+              if (chg > DaqListLastOdt(daq)) { // Nothing changed
+                  if (++DaqListChangeCycle(daq) >= DaqListKeepAlive(daq)) DaqListChangeCycle(daq) = 0;
+                  continue;
+              }
+              cmp = TRUE;
+          }
+          if (++DaqListChangeCycle(daq) >= DaqListKeepAlive(daq)) DaqListChangeCycle(daq) = 0;
+      }
+#endif
+      if (DaqListPriority(daq) > prio) prio = DaqListPriority(daq);
+
+      hs = (DaqListFlags(daq) & DAQ_FLAG_TIMESTAMP) ? XCP_DAQ_HDR_SIZE + 4 : XCP_DAQ_HDR_SIZE; // Timestamp in the first ODT only
+      for (odt=DaqListFirstOdt(daq);odt<=DaqListLastOdt(daq);hs=XCP_DAQ_HDR_SIZE,odt++)  {
 
-      for (hs=2+4,odt=DaqListFirstOdt(daq);odt<=DaqListLastOdt(daq);hs=2,odt++)  {
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+          if (cmp && odt != DaqListFirstOdt(daq)) { // Skip unchanged ODTs
+              if (odt < chg) continue;
+              if (odt > chg && !XcpOdtChanged(odt, base)) continue;
+          }
+#endif
 
           // Mutex to ensure transmit buffers with time stamp in ascending order
 #ifdef XCP_ENABLE_MULTITHREAD_EVENTS
+#ifdef XCP_ENABLE_PACKED_MODE
+          if (sc <= 1) // Packed DAQ lists are already locked
+#endif
           mutexLock(&ev->mutex);
 #endif
           // Get clock, if not given as parameter
           if (clock==0) clock = ApplXcpGetClock64();
 
           // Get DTO buffer
+#ifdef XCP_ENABLE_PACKED_MODE
+          d0 = XcpTlGetTransmitBuffer(&handle, (uint16_t)(DaqListOdtSize(odt) * (sc > 1 ? sc : 1) + hs));
+#else
           d0 = XcpTlGetTransmitBuffer(&handle, (uint16_t)(DaqListOdtSize(odt) + hs));
+#endif
 
 #ifdef XCP_ENABLE_MULTITHREAD_EVENTS
+#ifdef XCP_ENABLE_PACKED_MODE
+          if (sc <= 1)
+#endif
           mutexUnlock(&ev->mutex);
 #endif
 
@@ -735,12 +1924,28 @@ static void XcpEvent_(uint16_t event, uint8_t* base, uint64_t clock)
             XCP_DBG_PRINTF1("DAQ queue overflow! Event %u skipped\n", event);
             gXcp.DaqOverflowCount++;
             DaqListFlags(daq) |= DAQ_FLAG_OVERRUN;
+#if defined(XCP_ENABLE_MULTITHREAD_EVENTS) && defined(XCP_ENABLE_PACKED_MODE)
+            if (sc > 1) mutexUnlock(&ev->mutex);
+#endif
             return; // Skip rest of this event on queue overrun
         }
 
         // ODT,DAQ header
+#if XCP_DAQ_HDR_TYPE == DAQ_HDR_PID
+        d0[0] = (uint8_t)odt; /* Absolute odt number */
+#else
         d0[0] = (uint8_t)(odt-DaqListFirstOdt(daq)); /* Relative odt number */
+#endif
+#if XCP_DAQ_HDR_TYPE == DAQ_HDR_PID
+#elif XCP_DAQ_HDR_TYPE == DAQ_HDR_ODT_DAQB
         d0[1] = (uint8_t)daq;
+#elif XCP_DAQ_HDR_TYPE == DAQ_HDR_ODT_DAQW
+        d0[1] = (uint8_t)daq; // DAQ list number WORD in CPU byte order
+        d0[2] = (uint8_t)(daq >> 8);
+#else
+        d0[1] = 0; // Fill byte
+        *((uint16_t*)&d0[2]) = (uint16_t)daq;
+#endif
 
         // Use BIT7 of PID or ODT to indicate overruns
         if ( (DaqListFlags(daq) & DAQ_FLAG_OVERRUN) != 0 ) {
@@ -749,32 +1954,45 @@ static void XcpEvent_(uint16_t event, uint8_t* base, uint64_t clock)
         }
 
         // Timestamp
-        if (hs == 6) {
-            *((uint32_t*)&d0[2]) = (uint32_t)clock;
+        if (hs == XCP_DAQ_HDR_SIZE + 4) {
+#if XCP_DAQ_HDR_SIZE == 1 || XCP_DAQ_HDR_SIZE == 3
+            uint32_t t = (uint32_t)clock;
+            memcpy(&d0[XCP_DAQ_HDR_SIZE], &t, 4); // Not aligned
+#else
+            *((uint32_t*)&d0[XCP_DAQ_HDR_SIZE]) = (uint32_t)clock;
+#endif
         }
 
         // Copy data 
-        /* This is the inner loop, optimize here */
-        e = DaqListOdtFirstEntry(odt);
-        if (OdtEntrySize(e) != 0) {
-            el = DaqListOdtLastEntry(odt);
-            d = &d0[hs];
-            while (e <= el) { // inner DAQ loop
-                n = OdtEntrySize(e);
-                if (n == 0) break;
 #ifdef XCP_ENABLE_PACKED_MODE
-                if (sc>1) n *= sc; // packed mode
+        if (sc > 1) { // Packed mode, copy the staging buffer
+            memcpy(&d0[hs], DaqListOdtStaging(odt), DaqListOdtSize(odt) * sc);
+            XcpTlCommitTransmitBuffer(handle);
+            continue;
+        }
+#endif
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+        if (DaqListOdtSeqLockMask(odt) != 0) {
+            XcpCopyOdtConsistent(&d0[hs], odt, base);
+        }
+        else
 #endif
-                memcpy((uint8_t*)d, &base[OdtEntryAddr(e)], n);
-                d += n;
-                e++;
-            } // ODT entry
+        {
+            XcpCopyOdt(&d0[hs], odt, base);
         }
 
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+        if (DaqListKeepAlive(daq) != 0) memcpy(DaqListOdtShadow(odt), &d0[hs], DaqListOdtSize(odt)); // Update the shadow copy with the data sent
+#endif
+
         XcpTlCommitTransmitBuffer(handle);
 
       } /* odt */
 
+#if defined(XCP_ENABLE_MULTITHREAD_EVENTS) && defined(XCP_ENABLE_PACKED_MODE)
+      if (sc > 1) mutexUnlock(&ev->mutex);
+#endif
+
   } /* daq */
 
   if (prio>0 && handle!=NULL) XcpTlFlushTransmitBuffer();
@@ -795,15 +2013,7 @@ void XcpEventExt(uint16_t event, uint8_t* base) {
 
 #ifdef XCP_ENABLE_DYN_ADDRESSING
     if (!isStarted()) return;
-    if (isCmdPending()) { // Pending command, check if it can be executed in this context
-        if (gXcp.MtaExt == 1 && (uint16_t)(gXcp.MtaAddr >> 16) == event) {
-            // Convert MtaPtr to context
-            gXcp.MtaPtr = base + (gXcp.MtaAddr & 0xFFFF);
-            gXcp.MtaExt = 0;
-            XcpCommand((const uint32_t*)&gXcp.Cro, gXcp.CroLen);
-            gXcp.SessionStatus &= (uint16_t)~SS_CMD_PENDING;
-        }
-    }
+    if (isCmdPending()) XcpExecuteCommands(event, base); // Pending commands, check if they can be executed in this context
 #endif
 
     if (!isDaqRunning()) return; // DAQ not running
@@ -840,31 +2050,18 @@ static void XcpSendResponse() {
 }
 
 
-//  Push XCP command which can not be executes in this context for later async execution
-#ifdef XCP_ENABLE_DYN_ADDRESSING
-static void XcpPushCommand() {
-    gXcp.SessionStatus |= (uint16_t)SS_CMD_PENDING;
-}
-#endif
-
-//  Handles incoming XCP commands
-void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
+//  Process the XCP command in gXcp.Cro
+static void XcpProcessCommand_()
 {
 
   uint8_t err = 0;
 
-  if (!isStarted()) return;
-  if (cmdLen >= sizeof(gXcp.Cro)) return;
-  
-  gXcp.CroLen = (uint8_t)cmdLen;
-  memcpy(&gXcp.Cro, cmdData, cmdLen);
-
   // Prepare the default response
   CRM_CMD = PID_RES; /* Response, no error */
   gXcp.CrmLen = 1; /* Length = 1 */
 
   // CONNECT ?
-  if (cmdLen==CRO_CONNECT_LEN && CRO_CMD==CC_CONNECT)
+  if (CRO_LEN==CRO_CONNECT_LEN && CRO_CMD==CC_CONNECT)
   {
 #ifdef XCP_ENABLE_DEBUG_PRINTS
       XCP_DBG_PRINTF2("CONNECT mode=%u\n", CRO_CONNECT_MODE);
@@ -874,11 +2071,34 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
       // Check application is ready for XCP connect 
       if (!ApplXcpConnect()) error(CRC_ACCESS_DENIED);
 
-    // Initialize Session Status
-    gXcp.SessionStatus = (uint16_t)(SS_INITIALIZED | SS_STARTED | SS_CONNECTED | SS_LEGACY_MODE);
+#ifdef XCP_ENABLE_DAQ_RESUME
+    // Keep the DAQ configuration loaded by XcpStart on the first CONNECT
+    if (!isConnected() && !isDaqRunning() && XcpCheckDaqConfig()) {
+        gXcp.SessionStatus = (uint16_t)(SS_INITIALIZED | SS_STARTED | SS_CONNECTED | SS_LEGACY_MODE | (gXcp.SessionStatus & SS_RESUME));
+        gXcp.DaqConfigLoaded = FALSE;
+    }
+    else
+#endif
+    {
+        // Initialize Session Status
+        gXcp.SessionStatus = (uint16_t)(SS_INITIALIZED | SS_STARTED | SS_CONNECTED | SS_LEGACY_MODE);
+
+        /* Reset DAQ */
+        XcpFreeDaq();
+    }
 
-    /* Reset DAQ */
-    XcpFreeDaq();
+#ifdef XCP_ENABLE_CAL_PAGE
+    if (gXcp.CalSeq) { // Close an open calibration sequence
+        gXcp.CalSeq = FALSE;
+        ApplXcpPublishCal();
+    }
+#endif
+#ifdef XCP_ENABLE_BLOCK_MODE
+    gXcp.DownloadRemaining = 0; // Discard an aborted master block
+#endif
+#ifdef XCP_ENABLE_POLL_LIST
+    XcpClearPollLists(); // A new session does not inherit the polling lists
+#endif
 
     // Response
     gXcp.CrmLen = CRM_CONNECT_LEN;
@@ -888,11 +2108,24 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
     CRM_CONNECT_MAX_DTO_SIZE = XCPTL_MAX_DTO_SIZE;
     CRM_CONNECT_RESOURCE = 0x00;                  /* Reset resource mask */
     CRM_CONNECT_RESOURCE |= (uint8_t)RM_DAQ;       /* Data Acquisition */
+#ifdef XCP_ENABLE_DAQ_STIM
+    CRM_CONNECT_RESOURCE |= (uint8_t)RM_STIM;      /* Stimulation */
+#endif
     CRM_CONNECT_COMM_BASIC = 0;
     CRM_CONNECT_COMM_BASIC |= (uint8_t)CMB_OPTIONAL;
+#ifdef XCP_ENABLE_BLOCK_MODE
+    CRM_CONNECT_COMM_BASIC |= (uint8_t)CMB_SERVER_BLOCK_MODE;
+#endif
 #if defined ( XCP_CPUTYPE_BIGENDIAN )
     CRM_CONNECT_COMM_BASIC |= (uint8_t)PI_MOTOROLA;
 #endif
+#ifdef XCP_ENABLE_DAQ_RESUME
+    if (gXcp.SessionStatus & SS_RESUME) {
+        XcpSendResponse(); // Transmit response and then resume DAQ
+        XcpResumeDaq();
+        return;
+    }
+#endif
 
   }
 
@@ -907,7 +2140,7 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
           return;
       }
 
-      if (cmdLen<1 || cmdLen>XCPTL_MAX_CTO_SIZE) error(CRC_CMD_SYNTAX);
+      if (CRO_LEN<1 || CRO_LEN>XCPTL_MAX_CTO_SIZE) error(CRC_CMD_SYNTAX);
 
       switch (CRO_CMD)
       {
@@ -932,8 +2165,14 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
             CRM_GET_COMM_MODE_INFO_COMM_OPTIONAL = 0;
             CRM_GET_COMM_MODE_INFO_QUEUE_SIZE = 0;
 #endif
+#ifdef XCP_ENABLE_BLOCK_MODE
+            CRM_GET_COMM_MODE_INFO_COMM_OPTIONAL |= CMO_MASTER_BLOCK_MODE;
+            CRM_GET_COMM_MODE_INFO_MAX_BS = XCP_MAX_BS;
+            CRM_GET_COMM_MODE_INFO_MIN_ST = XCP_MIN_ST;
+#else
             CRM_GET_COMM_MODE_INFO_MAX_BS = 0;
             CRM_GET_COMM_MODE_INFO_MIN_ST = 0;
+#endif
           }
           break;
 
@@ -977,10 +2216,57 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
               gXcp.CrmLen = CRM_GET_STATUS_LEN;
               CRM_GET_STATUS_STATUS = (uint8_t)(gXcp.SessionStatus&0xFF);
               CRM_GET_STATUS_PROTECTION = 0;
+              CRM_GET_STATUS_STATE_NUMBER = 0;
+#ifdef XCP_ENABLE_DAQ_RESUME
+              CRM_GET_STATUS_CONFIG_ID = gXcp.DaqConfigId; /* Session configuration ID of the persistent DAQ configuration */
+#else
               CRM_GET_STATUS_CONFIG_ID = 0; /* Session configuration ID not available. */
+#endif
             }
             break;
 
+#if defined(XCP_ENABLE_DAQ_RESUME) || defined(XCP_ENABLE_FREEZE_CAL_PAGE)
+          case CC_SET_REQUEST:
+            {
+              uint8_t mode = CRO_SET_REQUEST_MODE;
+              uint8_t supported = 0;
+#ifdef XCP_ENABLE_DAQ_RESUME
+              supported |= SET_REQUEST_STORE_DAQ_REQ_NO_RESUME | SET_REQUEST_STORE_DAQ_REQ_RESUME | SET_REQUEST_CLEAR_DAQ_REQ;
+#endif
+#ifdef XCP_ENABLE_FREEZE_CAL_PAGE
+              supported |= SET_REQUEST_STORE_CAL_REQ;
+#endif
+              if (CRO_LEN < CRO_SET_REQUEST_LEN) error(CRC_CMD_SYNTAX);
+              if (mode & ~supported) error(CRC_OUT_OF_RANGE);
+#ifdef XCP_ENABLE_FREEZE_CAL_PAGE
+              if (mode & SET_REQUEST_STORE_CAL_REQ) {
+                  gXcp.SessionStatus |= SS_STORE_CAL_REQ;
+                  err = ApplXcpFreezeCal();
+                  gXcp.SessionStatus &= (uint16_t)~SS_STORE_CAL_REQ;
+                  check_error(err);
+              }
+#endif
+#ifdef XCP_ENABLE_DAQ_RESUME
+              if (mode & SET_REQUEST_CLEAR_DAQ_REQ) {
+                  ApplXcpClearDaqConfig();
+                  gXcp.DaqConfigId = 0;
+                  XCP_DBG_PRINT1("Persistent DAQ configuration cleared\n");
+              }
+              if (mode & (SET_REQUEST_STORE_DAQ_REQ_NO_RESUME | SET_REQUEST_STORE_DAQ_REQ_RESUME)) {
+                  gXcp.SessionStatus |= SS_STORE_DAQ_REQ;
+                  err = XcpStoreDaqConfig(CRO_SET_REQUEST_CONFIG_ID, mode);
+                  gXcp.SessionStatus &= (uint16_t)~SS_STORE_DAQ_REQ;
+                  check_error(err);
+              }
+#endif
+              XcpSendResponse(); // Transmit response and then the completion events
+              if (mode & SET_REQUEST_STORE_CAL_REQ) XcpSendEvent(EVC_STORE_CAL, NULL, 0);
+              if (mode & SET_REQUEST_CLEAR_DAQ_REQ) XcpSendEvent(EVC_CLEAR_DAQ, NULL, 0);
+              if (mode & (SET_REQUEST_STORE_DAQ_REQ_NO_RESUME | SET_REQUEST_STORE_DAQ_REQ_RESUME)) XcpSendEvent(EVC_STORE_DAQ, NULL, 0);
+              return;
+            }
+#endif
+
           case CC_SET_MTA:
             {            
               gXcp.MtaExt = CRO_SET_MTA_EXT;
@@ -996,28 +2282,86 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
           case CC_DOWNLOAD:
           {
               uint8_t size = CRO_DOWNLOAD_SIZE;
+#ifdef XCP_ENABLE_BLOCK_MODE
+              gXcp.DownloadRemaining = 0;
+              if (size > CRO_DOWNLOAD_MAX_SIZE) { // First packet of a master block, no response until the last DOWNLOAD_NEXT
+                  if (CRO_LEN < CRO_DOWNLOAD_LEN + CRO_DOWNLOAD_MAX_SIZE) error(CRC_CMD_SYNTAX);
+                  check_result(XcpWriteMta(CRO_DOWNLOAD_MAX_SIZE, CRO_DOWNLOAD_DATA));
+                  gXcp.DownloadRemaining = (uint8_t)(size - CRO_DOWNLOAD_MAX_SIZE);
+                  return;
+              }
+#else
               if (size > CRO_DOWNLOAD_MAX_SIZE) error(CRC_OUT_OF_RANGE)
+#endif
               check_result(XcpWriteMta(size, CRO_DOWNLOAD_DATA));
+#ifdef XCP_ENABLE_CAL_PAGE
+              if (!gXcp.CalSeq) check_error(XcpPublishCal());
+#endif
+          }
+          break;
+
+#ifdef XCP_ENABLE_BLOCK_MODE
+          case CC_DOWNLOAD_NEXT:
+          {
+              uint8_t size = CRO_DOWNLOAD_NEXT_SIZE;
+              if (size != gXcp.DownloadRemaining || size == 0) { // Lost or unexpected packet, the response contains the number of bytes expected
+                  gXcp.CrmLen = 3;
+                  CRM_CMD = PID_ERR;
+                  CRM_ERR = CRC_SEQUENCE;
+                  CRM_BYTE(2) = gXcp.DownloadRemaining;
+                  gXcp.DownloadRemaining = 0;
+                  break;
+              }
+              uint8_t n = size > CRO_DOWNLOAD_NEXT_MAX_SIZE ? CRO_DOWNLOAD_NEXT_MAX_SIZE : size;
+              if (CRO_LEN < CRO_DOWNLOAD_NEXT_LEN + n) error(CRC_CMD_SYNTAX);
+              check_result(XcpWriteMta(n, CRO_DOWNLOAD_NEXT_DATA));
+              gXcp.DownloadRemaining = (uint8_t)(size - n);
+              if (gXcp.DownloadRemaining > 0) return; // More packets in this block
+#ifdef XCP_ENABLE_CAL_PAGE
+              if (!gXcp.CalSeq) check_error(XcpPublishCal()); // The block is published as a whole
+#endif
           }
           break;
+#endif
 
           case CC_SHORT_DOWNLOAD:
           {
               uint8_t size = CRO_SHORT_DOWNLOAD_SIZE;
               if (size > CRO_SHORT_DOWNLOAD_MAX_SIZE) error(CRC_OUT_OF_RANGE)
-              if (!isCmdPending()) {
+              if (!isCmdDeferred()) {
                   gXcp.MtaExt = CRO_SHORT_DOWNLOAD_EXT;
                   gXcp.MtaAddr = CRO_SHORT_DOWNLOAD_ADDR;
                   gXcp.MtaPtr = ApplXcpGetPointer(gXcp.MtaExt, gXcp.MtaAddr);
               }
               check_result(XcpWriteMta(size, CRO_SHORT_DOWNLOAD_DATA));
+#ifdef XCP_ENABLE_CAL_PAGE
+              if (!gXcp.CalSeq) check_error(XcpPublishCal());
+#endif
           }
           break;
 
           case CC_UPLOAD:
             {
               uint8_t size = CRO_UPLOAD_SIZE;
+#ifdef XCP_ENABLE_BLOCK_MODE
+              if (size > CRM_UPLOAD_MAX_SIZE) { // Server block mode, the data is read completely and then transmitted as consecutive response packets
+                  uint8_t data[255];
+                  check_result(XcpReadMta(size, data));
+                  XcpCmdUnlock(); // The transmission may block
+                  for (uint8_t i = 0; i < size; ) {
+                      uint8_t n = (uint8_t)(size - i) > CRM_UPLOAD_MAX_SIZE ? CRM_UPLOAD_MAX_SIZE : (uint8_t)(size - i);
+                      CRM_CMD = PID_RES;
+                      memcpy(CRM_UPLOAD_DATA, &data[i], n);
+                      gXcp.CrmLen = (uint8_t)(CRM_UPLOAD_LEN + n);
+                      XcpSendResponse();
+                      i = (uint8_t)(i + n);
+                  }
+                  XcpCmdLock();
+                  return;
+              }
+#else
               if (size > CRM_UPLOAD_MAX_SIZE) error(CRC_OUT_OF_RANGE);
+#endif
               check_result(XcpReadMta(size,CRM_UPLOAD_DATA));
               gXcp.CrmLen = (uint8_t)(CRM_UPLOAD_LEN+size);
             }
@@ -1027,7 +2371,7 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
             {
               uint8_t size = CRO_SHORT_UPLOAD_SIZE;
               if (size > CRM_SHORT_UPLOAD_MAX_SIZE) error(CRC_OUT_OF_RANGE);
-              if (!isCmdPending()) {
+              if (!isCmdDeferred()) {
                   gXcp.MtaExt = CRO_SHORT_UPLOAD_EXT;
                   gXcp.MtaAddr = CRO_SHORT_UPLOAD_ADDR;
                   gXcp.MtaPtr = ApplXcpGetPointer(gXcp.MtaExt, gXcp.MtaAddr);
@@ -1050,23 +2394,127 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
               CRM_GET_CAL_PAGE_PAGE = ApplXcpGetCalPage(CRO_GET_CAL_PAGE_SEGMENT, CRO_GET_CAL_PAGE_MODE);
           }
           break;
+
+          case CC_COPY_CAL_PAGE:
+          {
+              check_error(ApplXcpCopyCalPage(CRO_COPY_CAL_PAGE_SRC_SEGMENT, CRO_COPY_CAL_PAGE_SRC_PAGE, CRO_COPY_CAL_PAGE_DEST_SEGMENT, CRO_COPY_CAL_PAGE_DEST_PAGE));
+              if (!gXcp.CalSeq) check_error(XcpPublishCal());
+          }
+          break;
+
+          case CC_GET_PAG_PROCESSOR_INFO:
+          {
+              gXcp.CrmLen = CRM_GET_PAG_PROCESSOR_INFO_LEN;
+              CRM_GET_PAG_PROCESSOR_INFO_MAX_SEGMENT = ApplXcpGetSegmentCount();
+#ifdef XCP_ENABLE_FREEZE_CAL_PAGE
+              CRM_GET_PAG_PROCESSOR_INFO_PROPERTIES = PAG_PROPERTY_FREEZE;
+#else
+              CRM_GET_PAG_PROCESSOR_INFO_PROPERTIES = 0;
+#endif
+          }
+          break;
+
+          case CC_GET_SEGMENT_INFO:
+          {
+              uint32_t addr, size;
+              if (!ApplXcpGetSegmentInfo(CRO_GET_SEGMENT_INFO_NUMBER, NULL, &addr, &size)) error(CRC_SEGMENT_NOT_VALID);
+              if (CRO_GET_SEGMENT_INFO_MODE == 0) { // Basic address info
+                  if (CRO_GET_SEGMENT_INFO_MAPPING_INDEX > 1) error(CRC_OUT_OF_RANGE);
+                  gXcp.CrmLen = CRM_GET_SEGMENT_INFO_LEN;
+                  CRM_BYTE(1) = CRM_BYTE(2) = CRM_BYTE(3) = 0;
+                  CRM_GET_SEGMENT_INFO_MAPPING_INFO = (CRO_GET_SEGMENT_INFO_MAPPING_INDEX == 0) ? addr : size;
+              }
+              else if (CRO_GET_SEGMENT_INFO_MODE == 1) { // Standard info
+                  gXcp.CrmLen = 6;
+                  CRM_GET_SEGMENT_INFO_MAX_PAGES = 2;
+                  CRM_GET_SEGMENT_INFO_ADDRESS_EXTENSION = 0;
+                  CRM_GET_SEGMENT_INFO_MAX_MAPPING = 0;
+                  CRM_GET_SEGMENT_INFO_COMPRESSION = 0;
+                  CRM_GET_SEGMENT_INFO_ENCRYPTION = 0;
+              }
+              else { // No address mapping info
+                  error(CRC_OUT_OF_RANGE);
+              }
+          }
+          break;
+
+          case CC_GET_PAGE_INFO:
+          {
+              if (!ApplXcpGetSegmentInfo(CRO_GET_PAGE_INFO_SEGMENT_NUMBER, NULL, NULL, NULL)) error(CRC_SEGMENT_NOT_VALID);
+              if (CRO_GET_PAGE_INFO_PAGE_NUMBER > 1) error(CRC_PAGE_NOT_VALID);
+              gXcp.CrmLen = CRM_GET_PAGE_INFO_LEN;
+              CRM_GET_PAGE_INFO_PROPERTIES = (uint8_t)(ECU_ACCESS_WITH | XCP_READ_ACCESS_WITH | (CRO_GET_PAGE_INFO_PAGE_NUMBER == 0 ? XCP_WRITE_ACCESS_WITH : XCP_WRITE_ACCESS_NONE));
+              CRM_GET_PAGE_INFO_INIT_SEGMENT = CRO_GET_PAGE_INFO_SEGMENT_NUMBER;
+          }
+          break;
+
+#ifdef XCP_ENABLE_FREEZE_CAL_PAGE
+          case CC_SET_SEGMENT_MODE:
+          {
+              if (CRO_LEN < CRO_SET_SEGMENT_MODE_LEN) error(CRC_CMD_SYNTAX);
+              check_error(ApplXcpSetSegmentMode(CRO_SET_SEGMENT_MODE_SEGMENT, CRO_SET_SEGMENT_MODE_MODE));
+          }
+          break;
+
+          case CC_GET_SEGMENT_MODE:
+          {
+              if (CRO_LEN < CRO_GET_SEGMENT_MODE_LEN) error(CRC_CMD_SYNTAX);
+              if (!ApplXcpGetSegmentInfo(CRO_GET_SEGMENT_MODE_SEGMENT, NULL, NULL, NULL)) error(CRC_SEGMENT_NOT_VALID);
+              gXcp.CrmLen = CRM_GET_SEGMENT_MODE_LEN;
+              CRM_BYTE(1) = 0;
+              CRM_GET_SEGMENT_MODE_MODE = ApplXcpGetSegmentMode(CRO_GET_SEGMENT_MODE_SEGMENT);
+          }
+          break;
+#endif
+
+#endif
+
+#if defined(XCP_ENABLE_CAL_PAGE) || defined(XCP_ENABLE_POLL_LIST)
+          case CC_USER_CMD:
+          {
+              if (CRO_LEN < CRO_USER_CMD_LEN) error(CRC_CMD_SYNTAX);
+              switch (CRO_USER_CMD_SUBCOMMAND) {
+#ifdef XCP_ENABLE_CAL_PAGE
+              case XCP_USER_CMD_CAL_BEGIN:
+                  gXcp.CalSeq = TRUE;
+                  break;
+              case XCP_USER_CMD_CAL_END:
+                  gXcp.CalSeq = FALSE;
+                  check_error(XcpPublishCal());
+                  break;
+#endif
+#ifdef XCP_ENABLE_POLL_LIST
+              case XCP_USER_CMD_POLL_CLEAR:
+                  if (CRO_LEN < 3) error(CRC_CMD_SYNTAX);
+                  if (CRO_BYTE(2) >= XCP_MAX_POLL_LISTS) error(CRC_OUT_OF_RANGE);
+                  gXcp.PollList[CRO_BYTE(2)].count = 0;
+                  gXcp.PollList[CRO_BYTE(2)].size = 0;
+                  break;
+              case XCP_USER_CMD_POLL_ADD:
+                  if (CRO_LEN < 4 || CRO_LEN < 4 + 6 * CRO_BYTE(3)) error(CRC_CMD_SYNTAX);
+                  check_error(XcpAddPollEntries(CRO_BYTE(2), CRO_BYTE(3), &CRO_BYTE(4)));
+                  break;
+              case XCP_USER_CMD_POLL:
+                  if (CRO_LEN < 3) error(CRC_CMD_SYNTAX);
+                  check_error(XcpPoll(CRO_BYTE(2), &CRM_BYTE(1)));
+                  gXcp.CrmLen = (uint8_t)(CRM_USER_CMD_LEN + gXcp.PollList[CRO_BYTE(2)].size);
+                  break;
 #endif
+              default:
+                  error(CRC_OUT_OF_RANGE);
+              }
+          }
+          break;
+#endif // XCP_ENABLE_CAL_PAGE || XCP_ENABLE_POLL_LIST
 
 
 #if defined ( XCP_ENABLE_CHECKSUM )
           case CC_BUILD_CHECKSUM: /* Build Checksum */
           {
-              uint32_t n = CRO_BUILD_CHECKSUM_SIZE;
               uint32_t s = 0;
-              uint32_t d,i;
-              if (n % 4 != 0) error(CRC_OUT_OF_RANGE)
-              n = n / 4;
-              for (i = 0; i < n; i++) { 
-                  check_error(XcpReadMta(4, (uint8_t*)&d)); 
-                  s += d; 
-              }
+              check_result(XcpBuildChecksum(CRO_BUILD_CHECKSUM_SIZE, &s));
               CRM_BUILD_CHECKSUM_RESULT = s;
-              CRM_BUILD_CHECKSUM_TYPE = XCP_CHECKSUM_TYPE_ADD44;
+              CRM_BUILD_CHECKSUM_TYPE = XCP_CHECKSUM_TYPE;
               gXcp.CrmLen = CRM_BUILD_CHECKSUM_LEN;
           }
           break;
@@ -1083,8 +2531,17 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
 #else
               CRM_GET_DAQ_PROCESSOR_INFO_MAX_EVENT = 0; /* Unknown */
 #endif
-              CRM_GET_DAQ_PROCESSOR_INFO_DAQ_KEY_BYTE = (uint8_t)DAQ_HDR_ODT_DAQB; /* DTO identification field type: Relative ODT number, absolute list number (BYTE) */
+              CRM_GET_DAQ_PROCESSOR_INFO_DAQ_KEY_BYTE = (uint8_t)XCP_DAQ_HDR_TYPE; /* DTO identification field type: Relative ODT number, absolute list number */
               CRM_GET_DAQ_PROCESSOR_INFO_PROPERTIES = (uint8_t)( DAQ_PROPERTY_CONFIG_TYPE | DAQ_PROPERTY_TIMESTAMP | DAQ_OVERLOAD_INDICATION_PID );
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+              CRM_GET_DAQ_PROCESSOR_INFO_PROPERTIES |= (uint8_t)DAQ_PROPERTY_PRESCALER;
+#endif
+#ifdef XCP_ENABLE_DAQ_RESUME
+              CRM_GET_DAQ_PROCESSOR_INFO_PROPERTIES |= (uint8_t)DAQ_PROPERTY_RESUME;
+#endif
+#ifdef XCP_ENABLE_DAQ_STIM
+              CRM_GET_DAQ_PROCESSOR_INFO_PROPERTIES |= (uint8_t)DAQ_PROPERTY_BIT_STIM;
+#endif
             }
             break;
 
@@ -1101,7 +2558,10 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
 #else
                         XCP_TIMESTAMP_UNIT |
 #endif
-                        DAQ_TIMESTAMP_FIXED | DAQ_TIMESTAMP_DWORD;
+#ifndef XCP_ENABLE_DAQ_NO_TIMESTAMP
+                        DAQ_TIMESTAMP_FIXED |
+#endif
+                        DAQ_TIMESTAMP_DWORD;
                 CRM_GET_DAQ_RESOLUTION_INFO_TIMESTAMP_TICKS = (XCP_TIMESTAMP_TICKS);
               }
               break;
@@ -1114,8 +2574,11 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
                 if (event==NULL) error(CRC_OUT_OF_RANGE);
                 gXcp.CrmLen = CRM_GET_DAQ_EVENT_INFO_LEN;
                 CRM_GET_DAQ_EVENT_INFO_PROPERTIES = DAQ_EVENT_PROPERTIES_DAQ | DAQ_EVENT_PROPERTIES_EVENT_CONSISTENCY;
+#ifdef XCP_ENABLE_DAQ_STIM
+                CRM_GET_DAQ_EVENT_INFO_PROPERTIES |= DAQ_EVENT_PROPERTIES_STIM;
+#endif
 #ifdef XCP_ENABLE_PACKED_MODE
-                if (ApplXcpEventList[event].sampleCount) CRM_GET_DAQ_EVENT_INFO_PROPERTIES |= DAQ_EVENT_PROPERTIES_PACKED;
+                if (event->sampleCount) CRM_GET_DAQ_EVENT_INFO_PROPERTIES |= DAQ_EVENT_PROPERTIES_PACKED;
 #endif
                 // if (event->size) CRM_GET_DAQ_EVENT_INFO_PROPERTIES |= DAQ_EVENT_PROPERTIES_EXT; @@@@ V1.6
                 CRM_GET_DAQ_EVENT_INFO_MAX_DAQ_LIST = 0xFF;
@@ -1168,7 +2631,11 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
               if (daq >= gXcp.Daq.DaqCount) error(CRC_OUT_OF_RANGE);
               gXcp.CrmLen = CRM_GET_DAQ_LIST_MODE_LEN;
               CRM_GET_DAQ_LIST_MODE_MODE = DaqListFlags(daq);
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+              CRM_GET_DAQ_LIST_MODE_PRESCALER = DaqListPrescaler(daq) > 1 ? DaqListPrescaler(daq) : 1;
+#else
               CRM_GET_DAQ_LIST_MODE_PRESCALER = 1;
+#endif
               CRM_GET_DAQ_LIST_MODE_EVENTCHANNEL = DaqListEventChannel(daq);
               CRM_GET_DAQ_LIST_MODE_PRIORITY = DaqListPriority(daq);
             }
@@ -1181,10 +2648,26 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
               uint8_t mode = CRO_SET_DAQ_LIST_MODE_MODE;
               uint8_t prio = CRO_SET_DAQ_LIST_MODE_PRIORITY;
               if (daq >= gXcp.Daq.DaqCount) error(CRC_OUT_OF_RANGE);
-              if (mode & (DAQ_FLAG_NO_PID | DAQ_FLAG_RESUME | DAQ_FLAG_DIRECTION | DAQ_FLAG_CMPL_DAQ_CH | DAQ_FLAG_SELECTED | DAQ_FLAG_RUNNING)) error(CRC_OUT_OF_RANGE);  // no pid, resume, stim not supported
+#ifdef XCP_ENABLE_DAQ_RESUME
+              uint8_t unsupported = (uint8_t)(mode & ~DAQ_FLAG_RESUME); // Resume mode supported
+#else
+              uint8_t unsupported = mode;
+#endif
+#ifdef XCP_ENABLE_DAQ_STIM
+              if (unsupported & (DAQ_FLAG_NO_PID | DAQ_FLAG_RESUME | DAQ_FLAG_CMPL_DAQ_CH | DAQ_FLAG_SELECTED | DAQ_FLAG_RUNNING)) error(CRC_OUT_OF_RANGE);  // no pid, resume not supported
+#ifndef XCP_ENABLE_DAQ_NO_TIMESTAMP
+              if (0==(mode & (DAQ_FLAG_TIMESTAMP | DAQ_FLAG_SELECTED | DAQ_FLAG_DIRECTION))) error(CRC_OUT_OF_RANGE);  // No timestamp not supported for DAQ
+#endif
+#else
+              if (unsupported & (DAQ_FLAG_NO_PID | DAQ_FLAG_RESUME | DAQ_FLAG_DIRECTION | DAQ_FLAG_CMPL_DAQ_CH | DAQ_FLAG_SELECTED | DAQ_FLAG_RUNNING)) error(CRC_OUT_OF_RANGE);  // no pid, resume, stim not supported
+#ifndef XCP_ENABLE_DAQ_NO_TIMESTAMP
               if (0==(mode & (DAQ_FLAG_TIMESTAMP | DAQ_FLAG_SELECTED))) error(CRC_OUT_OF_RANGE);  // No timestamp not supported
+#endif
+#endif
+#ifndef XCP_ENABLE_DAQ_PRESCALER
               if (CRO_SET_DAQ_LIST_MODE_PRESCALER > 1) error(CRC_OUT_OF_RANGE); // prescaler not supportet
-              check_error(XcpSetDaqListMode(daq, event, mode, prio));
+#endif
+              check_error(XcpSetDaqListMode(daq, event, mode, prio, CRO_SET_DAQ_LIST_MODE_PRESCALER));
               break;
             }
 
@@ -1216,6 +2699,9 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
               if ( (CRO_START_STOP_MODE==1 ) || (CRO_START_STOP_MODE==2) )  { // start or select
                 DaqListFlags(daq) |= (uint8_t)DAQ_FLAG_SELECTED;
                 if (CRO_START_STOP_MODE == 1) { // start individual daq list
+#ifdef XCP_DAQ_PREPARE
+                    check_error(XcpPrepareDaqLists());
+#endif
                     XcpStartDaq(daq);
                 }
                 gXcp.CrmLen = CRM_START_STOP_LEN;
@@ -1223,7 +2709,9 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
               }
               else {
                 if (XcpStopDaq(daq)) {
+                    XcpCmdUnlock();
                     XcpTlWaitForTransmitQueue(); // Event processing stopped - wait until transmit queue empty before sending command response
+                    XcpCmdLock();
                 }
               }
 
@@ -1243,6 +2731,9 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
                   XcpStopAllSelectedDaq();
                   break;
               case 1: /* start selected */
+#ifdef XCP_DAQ_PREPARE
+                  check_error(XcpPrepareDaqLists());
+#endif
                   if (!ApplXcpStartDaq()) error(CRC_RESOURCE_TEMPORARY_NOT_ACCESSIBLE);
                   XcpSendResponse(); // Transmit response and then start DAQ
                   XcpStartAllSelectedDaq();
@@ -1250,7 +2741,9 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
               case 0: /* stop all */
                   ApplXcpStopDaq();
                   XcpStopAllDaq();
+                  XcpCmdUnlock();
                   XcpTlWaitForTransmitQueue(); // Wait until transmit queue empty before sending command response
+                  XcpCmdLock();
                   break;
               default:
                   error(CRC_OUT_OF_RANGE);
@@ -1410,7 +2903,21 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
                   if (daq >= gXcp.Daq.DaqCount) error(CRC_OUT_OF_RANGE);
                   if (CRO_SET_DAQ_LIST_PACKED_MODE_MODE!=0x01) error(CRC_DAQ_CONFIG); // only element grouped implemented
                   //if (CRO_SET_DAQ_LIST_PACKED_MODE_TIMEMODE != 0x00) error(CRC_DAQ_CONFIG); // early or late timestamp implemented ?
+                  if (isDaqRunning() && (DaqListFlags(daq) & DAQ_FLAG_RUNNING)) error(CRC_DAQ_ACTIVE);
                   DaqListSampleCount(daq) = CRO_SET_DAQ_LIST_PACKED_MODE_SAMPLECOUNT;
+                  DaqListSampleIndex(daq) = 0;
+              }
+              break;
+
+              case CC_GET_DAQ_LIST_PACKED_MODE:
+              {
+                  uint16_t daq = CRO_GET_DAQ_LIST_PACKED_MODE_DAQ;
+                  if (daq >= gXcp.Daq.DaqCount) error(CRC_OUT_OF_RANGE);
+                  gXcp.CrmLen = CRM_GET_DAQ_LIST_PACKED_MODE_LEN;
+                  CRM_GET_DAQ_LIST_PACKED_MODE_RES = 0;
+                  CRM_GET_DAQ_LIST_PACKED_MODE_MODE = (uint8_t)(DaqListSampleCount(daq) > 1 ? 0x01 : 0x00); // element grouped or not packed
+                  CRM_GET_DAQ_LIST_PACKED_MODE_TIMEMODE = 0x00; // timestamp of the last sample
+                  CRM_GET_DAQ_LIST_PACKED_MODE_SAMPLECOUNT = DaqListSampleCount(daq);
               }
               break;
   #endif
@@ -1442,12 +2949,32 @@ void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
   return;
 
   // Return with no responce in case of async commands
-#ifdef XCP_ENABLE_DYN_ADDRESSING
+#ifdef XCP_CMD_QUEUE
   no_response:
 #endif
   return;
 }
 
+//  Handles incoming XCP commands
+void XcpCommand( const uint32_t* cmdData, uint16_t cmdLen )
+{
+  if (!isStarted()) return;
+#ifdef XCP_ENABLE_DAQ_STIM
+  if (cmdLen >= 2 && *(const uint8_t*)cmdData < 0xC0) { // STIM DTO
+      XcpStim((const uint8_t*)cmdData, cmdLen);
+      return;
+  }
+#endif
+  if (cmdLen > sizeof(gXcp.Cro)) return;
+#ifdef XCP_CMD_QUEUE
+  if (isCmdPending() && XcpQueueCommand((const uint8_t*)cmdData, cmdLen)) return; // Commands pending
+#endif
+
+  gXcp.CroLen = (uint8_t)cmdLen;
+  memcpy(&gXcp.Cro, cmdData, cmdLen);
+  XcpProcessCommand();
+}
+
 
 /*****************************************************************************
 | Event
@@ -1461,7 +2988,7 @@ void XcpSendEvent(uint8_t evc, const uint8_t* d, uint8_t l)
         CRM_BYTE(0) = PID_EV; /* Event*/
         CRM_BYTE(1) = evc;  /* Event Code*/
         gXcp.CrmLen = 2;
-        for (i = 0; i < l; i++) CRM_BYTE(gXcp.CrmLen++) = d[i++];
+        for (i = 0; i < l; i++) CRM_BYTE(gXcp.CrmLen++) = d[i];
         XcpSendResponse();
     }
 }
@@ -1475,6 +3002,23 @@ void XcpInit( void )
 {
   /* Initialize all XCP variables to zero */
   memset((uint8_t*)&gXcp,0,sizeof(gXcp));
+
+#ifdef XCP_ENABLE_DAQ_ARENA
+  gXcp.Daq.u.b = memoryReserve(XCP_DAQ_MEM_SIZE); // Reserve the DAQ memory address space
+#endif
+
+#ifdef XCP_ENABLE_CHECKSUM
+  XcpInitChecksum();
+#endif
+#ifdef XCP_CMD_QUEUE
+  mutexInit(&gXcp.CmdQueueMutex, 0, 1000);
+#endif
+#if XCP_MAX_SERVERS > 1
+  if (!gXcpCmdMutexInit) { // Shared by all server instances, initialized by the first one
+      mutexInit(&gXcpCmdMutex, 0, 1000);
+      gXcpCmdMutexInit = TRUE;
+  }
+#endif
   
 #if XCP_PROTOCOL_LAYER_VERSION >= 0x0103
 
@@ -1490,7 +3034,7 @@ void XcpInit( void )
 
 #ifdef XCP_ENABLE_DEBUG_PRINTS
   XCP_DBG_PRINT2("\nInit XCP protocol layer\n");
-  XCP_DBG_PRINTF2("  Version=%u.%u, MAXEV=%u, MAXCTO=%u, MAXDTO=%u, DAQMEM=%u, MAXDAQ=%u, MAXENTRY=%u, MAXENTRYSIZE=%u)\n", XCP_PROTOCOL_LAYER_VERSION >> 8, XCP_PROTOCOL_LAYER_VERSION & 0xFF, XCP_MAX_EVENT, XCPTL_MAX_CTO_SIZE, XCPTL_MAX_DTO_SIZE, XCP_DAQ_MEM_SIZE, (1 << sizeof(uint16_t) * 8) - 1, (1 << sizeof(uint16_t) * 8) - 1, (1 << (sizeof(uint8_t) * 8)) - 1);
+  XCP_DBG_PRINTF2("  Version=%u.%u, MAXEV=%u, MAXCTO=%u, MAXDTO=%u, DAQMEM=%u, MAXDAQ=%u, MAXENTRY=%u, MAXENTRYSIZE=%u)\n", XCP_PROTOCOL_LAYER_VERSION >> 8, XCP_PROTOCOL_LAYER_VERSION & 0xFF, XCP_MAX_EVENT, XCPTL_MAX_CTO_SIZE, XCPTL_MAX_DTO_SIZE, XCP_DAQ_MEM_SIZE, XCP_MAX_DAQ, XCP_DAQ_MEM_SIZE / 5, (1 << (sizeof(uint8_t) * 8)) - 1);
   XCP_DBG_PRINTF2("  %u KiB memory used\n", (unsigned int)sizeof(gXcp)/1024);
   XCP_DBG_PRINT2("  Options=(");
 
@@ -1507,6 +3051,30 @@ void XcpInit( void )
 #ifdef XCP_ENABLE_PACKED_MODE  // Enable packed DAQ events
   XCP_DBG_PRINT2("PACKED_MODE,");
 #endif
+#ifdef XCP_ENABLE_DAQ_PRESCALER  // Enable DAQ list prescaler
+  XCP_DBG_PRINT2("DAQ_PRESCALER,");
+#endif
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE  // Enable on change DAQ events
+  XCP_DBG_PRINT2("DAQ_ON_CHANGE,");
+#endif
+#ifdef XCP_ENABLE_DAQ_SEQLOCK  // Enable consistent sampling with sequence counters
+  XCP_DBG_PRINT2("DAQ_SEQLOCK,");
+#endif
+#ifdef XCP_ENABLE_DAQ_STIM  // Enable stimulation
+  XCP_DBG_PRINT2("DAQ_STIM,");
+#endif
+#ifdef XCP_ENABLE_DAQ_ARENA  // Enable on demand committed DAQ memory
+  XCP_DBG_PRINT2("DAQ_ARENA,");
+#endif
+#ifdef XCP_ENABLE_DAQ_NO_TIMESTAMP  // Enable DAQ lists without timestamp
+  XCP_DBG_PRINT2("DAQ_NO_TIMESTAMP,");
+#endif
+#ifdef XCP_ENABLE_DAQ_RESUME  // Enable persistent DAQ configuration and resume mode
+  XCP_DBG_PRINT2("DAQ_RESUME,");
+#endif
+#ifdef XCP_ENABLE_FREEZE_CAL_PAGE  // Enable persistent calibration pages
+  XCP_DBG_PRINT2("FREEZE_CAL_PAGE,");
+#endif
 #ifdef XCP_ENABLE_IDT_A2L_UPLOAD // Enable A2L upload to host
   XCP_DBG_PRINT2("A2L_UPLOAD,");
 #endif
@@ -1522,6 +3090,15 @@ void XcpInit( void )
 #ifdef XCP_ENABLE_CHECKSUM // Enable BUILD_CHECKSUM command
   XCP_DBG_PRINT2("CHECKSUM,");
 #endif
+#ifdef XCP_ENABLE_BLOCK_MODE // Enable master and server block mode
+  XCP_DBG_PRINT2("BLOCK_MODE,");
+#endif
+#ifdef XCP_ENABLE_POLL_LIST // Enable USER_CMD polling lists
+  XCP_DBG_PRINT2("POLL_LIST,");
+#endif
+#ifdef XCP_ENABLE_ASYNC_CMD // Enable async command execution in the worker thread
+  XCP_DBG_PRINT2("ASYNC_CMD,");
+#endif
 #ifdef XCP_ENABLE_INTERLEAVED // Enable interleaved command execution
   XCP_DBG_PRINT2("INTERLEAVED,");
 #endif
@@ -1579,6 +3156,10 @@ void XcpStart(void)
 #endif
 
     gXcp.SessionStatus |= SS_STARTED;
+
+#ifdef XCP_ENABLE_DAQ_RESUME
+    XcpLoadDaqConfig();
+#endif
 }
 
 
@@ -1639,6 +3220,9 @@ uint16_t XcpCreateEvent(const char* name, uint32_t cycleTimeNs, uint8_t priority
     gXcp.EventList[e].priority = priority;
     gXcp.EventList[e].sampleCount = sampleCount;
     gXcp.EventList[e].size = size;
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+    gXcp.EventList[e].keepAlive = 0;
+#endif
 #ifdef XCP_ENABLE_TEST_CHECKS
     gXcp.EventList[e].time = 0;
 #endif
@@ -1654,6 +3238,86 @@ uint16_t XcpCreateEvent(const char* name, uint32_t cycleTimeNs, uint8_t priority
     return gXcp.EventCount++;
 }
 
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+// Set an event to on change mode, ODTs of DAQ lists associated to this event are only sent when their data changed
+// <keepAliveCycles> all ODTs are sent at least every keepAliveCycles event cycles, 0 = off
+// Must be called before DAQ lists are configured
+BOOL XcpSetEventOnChange(uint16_t event, uint16_t keepAliveCycles) {
+
+    tXcpEvent* e = XcpGetEvent(event);
+    if (e == NULL) return FALSE;
+    e->keepAlive = keepAliveCycles;
+    XCP_DBG_PRINTF1("Event %u: %s on change, keep alive=%u\n", event, e->name, keepAliveCycles);
+    return TRUE;
+}
+#endif
+
+#endif
+
+
+/**************************************************************************/
+// Consistent sampling
+/**************************************************************************/
+
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+
+// Register a memory region protected by a sequence counter
+// ODTs sampling this region are copied consistent to writes enclosed in XcpSeqLockWriteBegin/End
+// Must be called before DAQ is started
+BOOL XcpCreateSeqLockRegion(tXcpSeqLock* lock, const uint8_t* p, uint32_t size) {
+
+    if (!isStarted() || gXcp.SeqLockCount >= XCP_MAX_SEQLOCK) return FALSE;
+    gXcp.SeqLock[gXcp.SeqLockCount].addr = ApplXcpGetAddr((uint8_t*)p);
+    gXcp.SeqLock[gXcp.SeqLockCount].size = size;
+    gXcp.SeqLock[gXcp.SeqLockCount].lock = lock;
+    gXcp.SeqLockCount++;
+    return TRUE;
+}
+
+// Writer side, only one writer per sequence counter
+void XcpSeqLockWriteBegin(tXcpSeqLock* lock) {
+    atomicStore32(lock, *lock + 1); // odd, write in progress
+    atomicFence();
+}
+
+void XcpSeqLockWriteEnd(tXcpSeqLock* lock) {
+    atomicStore32(lock, *lock + 1); // even, write complete
+}
+
+#endif
+
+
+/**************************************************************************/
+// Live instances
+/**************************************************************************/
+
+#ifdef XCP_ENABLE_DYN_ADDRESSING
+
+// Must be called before the instance is destroyed, waits until direct accesses in progress are finished
+void XcpUnregisterInstance(uint16_t event) {
+
+    if (!isStarted() || event >= XCP_MAX_EVENT) return;
+    tXcpInstance* i = &gXcp.Instance[event];
+    i->base = NULL;
+    atomicFence();
+    while (atomicLoad32(&i->refs) != 0) sleepNs(10000);
+}
+
+// Register the instance with dynamic addressing (ext=1) of event at base
+// XCP_INSTANCE_DIRECT: Calibration and upload access directly from the command thread, aligned values are written with single stores
+// XCP_INSTANCE_CONSISTENT: Access deferred to the next XcpEventExt of the instance, consistent to the instance code
+BOOL XcpRegisterInstance(uint16_t event, uint8_t* base, uint32_t size, uint8_t mode) {
+
+    if (!isStarted() || event >= XCP_MAX_EVENT || base == NULL) return FALSE;
+    tXcpInstance* i = &gXcp.Instance[event];
+    XcpUnregisterInstance(event);
+    i->size = size;
+    i->mode = mode;
+    i->base = base;
+    atomicFence();
+    return TRUE;
+}
+
 #endif
 
 
@@ -1682,6 +3346,12 @@ static void XcpPrintCmd() {
         }
         break;
 
+#ifdef XCP_ENABLE_BLOCK_MODE
+    case CC_DOWNLOAD_NEXT:
+        printf("DOWNLOAD_NEXT size=%u\n", CRO_DOWNLOAD_NEXT_SIZE);
+        break;
+#endif
+
     case CC_SHORT_DOWNLOAD:
         if (XCP_DBG_LEVEL >= 3) {
             uint16_t i;
@@ -1713,6 +3383,39 @@ static void XcpPrintCmd() {
     case CC_GET_CAL_PAGE:
         printf("GET_CAL_PAGE segment=%u, mode=%u\n", CRO_GET_CAL_PAGE_SEGMENT, CRO_GET_CAL_PAGE_MODE);
         break;
+
+#ifdef XCP_ENABLE_FREEZE_CAL_PAGE
+    case CC_SET_SEGMENT_MODE:
+        printf("SET_SEGMENT_MODE segment=%u, mode=%02Xh\n", CRO_SET_SEGMENT_MODE_SEGMENT, CRO_SET_SEGMENT_MODE_MODE);
+        break;
+
+    case CC_GET_SEGMENT_MODE:
+        printf("GET_SEGMENT_MODE segment=%u\n", CRO_GET_SEGMENT_MODE_SEGMENT);
+        break;
+#endif
+
+    case CC_COPY_CAL_PAGE:
+        printf("COPY_CAL_PAGE src segment=%u,page=%u -> dst segment=%u,page=%u\n", CRO_COPY_CAL_PAGE_SRC_SEGMENT, CRO_COPY_CAL_PAGE_SRC_PAGE, CRO_COPY_CAL_PAGE_DEST_SEGMENT, CRO_COPY_CAL_PAGE_DEST_PAGE);
+        break;
+
+    case CC_GET_PAG_PROCESSOR_INFO:
+        printf("GET_PAG_PROCESSOR_INFO\n");
+        break;
+
+    case CC_GET_SEGMENT_INFO:
+        printf("GET_SEGMENT_INFO mode=%u, segment=%u, mapping index=%u\n", CRO_GET_SEGMENT_INFO_MODE, CRO_GET_SEGMENT_INFO_NUMBER, CRO_GET_SEGMENT_INFO_MAPPING_INDEX);
+        break;
+
+    case CC_GET_PAGE_INFO:
+        printf("GET_PAGE_INFO segment=%u, page=%u\n", CRO_GET_PAGE_INFO_SEGMENT_NUMBER, CRO_GET_PAGE_INFO_PAGE_NUMBER);
+        break;
+
+#endif
+
+#if defined(XCP_ENABLE_CAL_PAGE) || defined(XCP_ENABLE_POLL_LIST)
+    case CC_USER_CMD:
+        printf("USER_CMD sub command=%02Xh\n", CRO_USER_CMD_SUBCOMMAND);
+        break;
 #endif
 
 #ifdef XCP_ENABLE_CHECKSUM
@@ -1741,6 +3444,12 @@ static void XcpPrintCmd() {
             printf("GET_STATUS\n");
             break;
 
+#if defined(XCP_ENABLE_DAQ_RESUME) || defined(XCP_ENABLE_FREEZE_CAL_PAGE)
+     case CC_SET_REQUEST:
+            printf("SET_REQUEST mode=%02Xh, configId=%u\n", CRO_SET_REQUEST_MODE, CRO_SET_REQUEST_CONFIG_ID);
+            break;
+#endif
+
      case CC_GET_DAQ_PROCESSOR_INFO:
             printf("GET_DAQ_PROCESSOR_INFO\n");
             break;
@@ -1776,7 +3485,7 @@ static void XcpPrintCmd() {
             break;
 
      case CC_SET_DAQ_LIST_MODE:
-            printf("SET_DAQ_LIST_MODE daq=%u, mode=%02Xh, eventchannel=%u\n",CRO_SET_DAQ_LIST_MODE_DAQ, CRO_SET_DAQ_LIST_MODE_MODE, CRO_SET_DAQ_LIST_MODE_EVENTCHANNEL);
+            printf("SET_DAQ_LIST_MODE daq=%u, mode=%02Xh, eventchannel=%u, prescaler=%u\n",CRO_SET_DAQ_LIST_MODE_DAQ, CRO_SET_DAQ_LIST_MODE_MODE, CRO_SET_DAQ_LIST_MODE_EVENTCHANNEL, CRO_SET_DAQ_LIST_MODE_PRESCALER);
             break;
 
      case CC_SET_DAQ_PTR:
@@ -1933,6 +3642,19 @@ static void XcpPrintRes() {
         case CC_GET_CAL_PAGE:
             printf("<- page=%u\n", CRM_GET_CAL_PAGE_PAGE);
             break;
+
+        case CC_GET_PAG_PROCESSOR_INFO:
+            printf("<- segments=%u, properties=%02Xh\n", CRM_GET_PAG_PROCESSOR_INFO_MAX_SEGMENT, CRM_GET_PAG_PROCESSOR_INFO_PROPERTIES);
+            break;
+
+        case CC_GET_SEGMENT_INFO:
+            if (CRO_GET_SEGMENT_INFO_MODE == 0) printf("<- %s=%08Xh\n", CRO_GET_SEGMENT_INFO_MAPPING_INDEX == 0 ? "addr" : "size", CRM_GET_SEGMENT_INFO_MAPPING_INFO);
+            else printf("<- max pages=%u\n", CRM_GET_SEGMENT_INFO_MAX_PAGES);
+            break;
+
+        case CC_GET_PAGE_INFO:
+            printf("<- properties=%02Xh\n", CRM_GET_PAGE_INFO_PROPERTIES);
+            break;
 #endif
 
 #ifdef XCP_ENABLE_CHECKSUM
@@ -2042,7 +3764,8 @@ static void XcpPrintRes() {
 
 static void XcpPrintDaqList( uint16_t daq )
 {
-  int i,e;
+  int i;
+  uint32_t e;
 
   if (daq>=gXcp.Daq.DaqCount) return;
 
@@ -2051,9 +3774,16 @@ static void XcpPrintDaqList( uint16_t daq )
   printf(" firstOdt=%u,",DaqListFirstOdt(daq));
   printf(" lastOdt=%u,",DaqListLastOdt(daq));
   printf(" flags=%02Xh,",DaqListFlags(daq));
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+  printf(" prescaler=%u,",DaqListPrescaler(daq));
+#endif
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+  printf(" keepAlive=%u,",DaqListKeepAlive(daq));
+#endif
 #ifdef XCP_ENABLE_PACKED_MODE
-  printf(" sampleCount=%u\n",DaqListSampleCount(daq));
+  printf(" sampleCount=%u,",DaqListSampleCount(daq));
 #endif
+  printf("\n");
   for (i=DaqListFirstOdt(daq);i<=DaqListLastOdt(daq);i++) {
     printf("  ODT %u (%u):",i-DaqListFirstOdt(daq),i);
     printf(" firstOdtEntry=%u, lastOdtEntry=%u, size=%u:\n", DaqListOdtFirstEntry(i), DaqListOdtLastEntry(i),DaqListOdtSize(i));
@@ -10,6 +10,79 @@
 #include "xcpTl.h"      // Transport layer interface
 
 
+/* DTO identification field type */
+#ifndef XCP_DAQ_HDR_TYPE
+#define XCP_DAQ_HDR_TYPE DAQ_HDR_ODT_DAQB // Relative ODT number, absolute DAQ list number (BYTE)
+#endif
+#if XCP_DAQ_HDR_TYPE == DAQ_HDR_PID
+#define XCP_DAQ_HDR_SIZE 1
+#define XCP_MAX_DAQ 0x80
+#define XCP_MAX_ODT 0x80 // Absolute ODT number (PID), bit 7 is the overload indication
+#define XCP_DAQ_HDR_A2L "IDENTIFICATION_FIELD_TYPE_ABSOLUTE"
+#elif XCP_DAQ_HDR_TYPE == DAQ_HDR_ODT_DAQB
+#define XCP_DAQ_HDR_SIZE 2
+#define XCP_MAX_DAQ 0xFF
+#define XCP_DAQ_HDR_A2L "IDENTIFICATION_FIELD_TYPE_RELATIVE_BYTE"
+#elif XCP_DAQ_HDR_TYPE == DAQ_HDR_ODT_DAQW
+#define XCP_DAQ_HDR_SIZE 3
+#define XCP_MAX_DAQ 0xFFFF
+#define XCP_DAQ_HDR_A2L "IDENTIFICATION_FIELD_TYPE_RELATIVE_WORD"
+#elif XCP_DAQ_HDR_TYPE == DAQ_HDR_ODT_FIL_DAQW
+#define XCP_DAQ_HDR_SIZE 4
+#define XCP_MAX_DAQ 0xFFFF
+#define XCP_DAQ_HDR_A2L "IDENTIFICATION_FIELD_TYPE_RELATIVE_WORD_ALIGNED"
+#else
+#error "Unsupported XCP_DAQ_HDR_TYPE"
+#endif
+#ifndef XCP_MAX_ODT
+#define XCP_MAX_ODT 0xFFFF
+#endif
+
+/* BUILD_CHECKSUM type */
+#ifndef XCP_CHECKSUM_TYPE
+#define XCP_CHECKSUM_TYPE XCP_CHECKSUM_TYPE_ADD44
+#endif
+#if XCP_CHECKSUM_TYPE == XCP_CHECKSUM_TYPE_ADD44
+#define XCP_CHECKSUM_A2L "XCP_ADD_44"
+#elif XCP_CHECKSUM_TYPE == XCP_CHECKSUM_TYPE_CRC16
+#define XCP_CHECKSUM_A2L "XCP_CRC_16"
+#elif XCP_CHECKSUM_TYPE == XCP_CHECKSUM_TYPE_CRC16CCITT
+#define XCP_CHECKSUM_A2L "XCP_CRC_16_CITT"
+#elif XCP_CHECKSUM_TYPE == XCP_CHECKSUM_TYPE_CRC32
+#define XCP_CHECKSUM_A2L "XCP_CRC_32"
+#else
+#error "Unsupported XCP_CHECKSUM_TYPE"
+#endif
+
+/* Polling lists */
+#ifdef XCP_ENABLE_POLL_LIST
+#ifndef XCP_MAX_POLL_LISTS
+#define XCP_MAX_POLL_LISTS 4
+#endif
+#ifndef XCP_MAX_POLL_ENTRIES
+#define XCP_MAX_POLL_ENTRIES 64 /* Max entries per list */
+#endif
+#endif
+
+/* Server instances */
+#ifndef XCP_MAX_SERVERS
+#define XCP_MAX_SERVERS 1
+#endif
+#if XCP_MAX_SERVERS > 1
+extern THREAD_LOCAL uint8_t gXcpSelectedServer; /* Used by the transport layer and server to select their instance data */
+#endif
+
+/* Block mode */
+#ifdef XCP_ENABLE_BLOCK_MODE
+#ifndef XCP_MAX_BS
+#define XCP_MAX_BS 2 /* Max number of DOWNLOAD and DOWNLOAD_NEXT packets in a master block, 255 bytes need 2 packets with MAX_CTO=252 */
+#endif
+#ifndef XCP_MIN_ST
+#define XCP_MIN_ST 0 /* Min separation time of master block packets in 100us */
+#endif
+#endif
+
+
 
 /****************************************************************************/
 /* DAQ event information                                                    */
@@ -25,6 +98,9 @@ typedef struct {
     uint16_t sampleCount; // packed event sample count
     uint16_t daqList; // associated DAQ list
     uint8_t priority; // priority 0 = queued, 1 = pushing, 2 = realtime
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+    uint16_t keepAlive; // on change mode keep alive cycles, 0 = off
+#endif
 #ifdef XCP_ENABLE_MULTITHREAD_EVENTS
     MUTEX mutex;
 #endif
@@ -45,6 +121,11 @@ extern void XcpInit(void);
 extern void XcpStart(void);
 extern void XcpDisconnect();
 
+/* Multiple server instances (XCP_MAX_SERVERS > 1) */
+/* The protocol and transport layer state of the server selected for the calling thread is used by all XCP functions, default is server 0 */
+extern void XcpSelectServer(uint8_t server);
+extern uint8_t XcpGetServer();
+
 /* Trigger a XCP data acquisition or stimulation event */
 extern void XcpEvent(uint16_t event);
 extern void XcpEventExt(uint16_t event, uint8_t* base);
@@ -53,6 +134,11 @@ extern void XcpEventAt(uint16_t event, uint64_t clock);
 /* XCP command processor */
 extern void XcpCommand( const uint32_t* pCommand, uint16_t len );
 
+#ifdef XCP_ENABLE_ASYNC_CMD
+/* Execute pending commands deferred to the worker thread, returns FALSE if there was nothing to do */
+extern BOOL XcpWorker();
+#endif
+
 /* Send an XCP event message */
 extern void XcpSendEvent(uint8_t evc, const uint8_t* d, uint8_t l);
 
@@ -64,6 +150,43 @@ extern BOOL XcpIsDaqPacked();
 extern uint64_t XcpGetDaqStartTime();
 extern uint32_t XcpGetDaqOverflowCount();
 
+/* Live instances with dynamic addressing (ext=1), accessed directly from the command thread */
+#ifdef XCP_ENABLE_DYN_ADDRESSING
+#define XCP_INSTANCE_DIRECT     0x00 /* Direct access from the command thread */
+#define XCP_INSTANCE_CONSISTENT 0x01 /* Access in the context of the instance event */
+extern BOOL XcpRegisterInstance(uint16_t event, uint8_t* base, uint32_t size, uint8_t mode);
+extern void XcpUnregisterInstance(uint16_t event);
+#endif
+
+/* Consistent sampling of multi word measurement objects */
+#ifdef XCP_ENABLE_DAQ_SEQLOCK
+typedef uint32_t tXcpSeqLock;
+extern BOOL XcpCreateSeqLockRegion(tXcpSeqLock* lock, const uint8_t* p, uint32_t size);
+extern void XcpSeqLockWriteBegin(tXcpSeqLock* lock);
+extern void XcpSeqLockWriteEnd(tXcpSeqLock* lock);
+extern uint32_t XcpGetDaqTornCount();
+#endif
+
+/* Stimulation */
+#ifdef XCP_ENABLE_DAQ_STIM
+extern uint32_t XcpGetStimOverrunCount();
+#endif
+
+/* Persistent DAQ configuration for resume mode, stored by SET_REQUEST and loaded by XcpStart */
+#ifdef XCP_ENABLE_DAQ_RESUME
+typedef struct {
+    uint32_t magic;               /* XCP_DAQ_CONFIG_MAGIC */
+    uint32_t layout;              /* DAQ table layout of the protocol layer configuration */
+    uint32_t epkHash;             /* ApplXcpGetEpkHash() of the application the DAQ tables refer to */
+    uint32_t size;                /* Size of the DAQ tables following this header */
+    uint32_t odtEntryCount;
+    uint16_t daqCount;
+    uint16_t odtCount;
+    uint16_t configId;            /* Session configuration id from SET_REQUEST */
+    uint16_t mode;                /* SET_REQUEST mode */
+} tXcpDaqConfig;
+#endif
+
 /* Time synchronisation */
 #ifdef XCP_ENABLE_DAQ_CLOCK_MULTICAST
 extern uint16_t XcpGetClusterId();
@@ -79,6 +202,10 @@ extern void XcpSetGrandmasterClockInfo(uint8_t* id, uint8_t epoch, uint8_t strat
 extern void XcpClearEventList();
 // Add a measurement event to event list, return event number (0..MAX_EVENT-1)
 extern uint16_t XcpCreateEvent(const char* name, uint32_t cycleTimeNs /* ns */, uint8_t priority /* 0-normal, >=1 realtime*/, uint16_t sampleCount, uint32_t size);
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+// Send only changed ODTs of DAQ lists associated to this event, all ODTs at least every keepAliveCycles
+extern BOOL XcpSetEventOnChange(uint16_t event, uint16_t keepAliveCycles);
+#endif
 // Get event list
 extern tXcpEvent* XcpGetEventList(uint16_t* eventCount);
 // Lookup event
@@ -104,10 +231,34 @@ extern uint8_t* ApplXcpGetPointer(uint8_t addr_ext, uint32_t addr);
 extern uint32_t ApplXcpGetAddr(uint8_t* p);
 extern uint8_t *ApplXcpGetBaseAddr();
 
-/* Switch calibration page */
+/* Check if size bytes at p are mapped readable (or writeable), NULL is never valid */
+extern BOOL ApplXcpCheckMemory(const uint8_t* p, uint32_t size, BOOL write);
+
+/* USER_CMD sub commands */
+#define XCP_USER_CMD_CAL_BEGIN 0x01 /* Begin a calibration sequence, downloads are published together at its end */
+#define XCP_USER_CMD_CAL_END   0x02 /* End a calibration sequence */
+#define XCP_USER_CMD_POLL_CLEAR 0x03 /* Clear polling list: id */
+#define XCP_USER_CMD_POLL_ADD   0x04 /* Add entries to polling list: id, n, n*(addr(4),ext,size), ext must be 0 */
+#define XCP_USER_CMD_POLL       0x05 /* Upload all variables of polling list: id, the response contains the values in list order */
+
+/* Calibration segments with page 0 (RAM, working page) and page 1 (ROM, default values) */
 #ifdef XCP_ENABLE_CAL_PAGE
+extern uint8_t ApplXcpGetSegmentCount();
+extern BOOL ApplXcpGetSegmentInfo(uint8_t segment, const char** name, uint32_t* addr, uint32_t* size);
 extern uint8_t ApplXcpGetCalPage(uint8_t segment, uint8_t mode);
 extern uint8_t ApplXcpSetCalPage(uint8_t segment, uint8_t page, uint8_t mode);
+extern uint8_t ApplXcpCopyCalPage(uint8_t srcSegment, uint8_t srcPage, uint8_t dstSegment, uint8_t dstPage);
+extern uint8_t ApplXcpPublishCal(); /* Calibration consistency point, after each download command or at the end of a USER_CMD calibration sequence, returns an error code */
+#endif
+
+/* Persistent calibration pages */
+#ifdef XCP_ENABLE_FREEZE_CAL_PAGE
+#ifndef XCP_ENABLE_CAL_PAGE
+#error "XCP_ENABLE_FREEZE_CAL_PAGE requires XCP_ENABLE_CAL_PAGE"
+#endif
+extern uint8_t ApplXcpSetSegmentMode(uint8_t segment, uint8_t mode);
+extern uint8_t ApplXcpGetSegmentMode(uint8_t segment);
+extern uint8_t ApplXcpFreezeCal(); /* SET_REQUEST STORE_CAL_REQ, store all segments in freeze mode */
 #endif
 
 /* DAQ clock */
@@ -117,6 +268,14 @@ extern uint8_t ApplXcpGetClockState();
 extern BOOL ApplXcpGetClockInfoGrandmaster(uint8_t* uuid, uint8_t* epoch, uint8_t* stratum);
 #endif
 
+/* Persistent DAQ configuration */
+#ifdef XCP_ENABLE_DAQ_RESUME
+extern BOOL ApplXcpStoreDaqConfig(const tXcpDaqConfig* config, const uint8_t* tables);
+extern BOOL ApplXcpLoadDaqConfig(tXcpDaqConfig* config, uint8_t* tables); // Load the header only, if tables is NULL
+extern void ApplXcpClearDaqConfig();
+extern uint32_t ApplXcpGetEpkHash(); // 0, if not available
+#endif
+
 /* Info (for GET_ID) */
 extern uint32_t ApplXcpGetId(uint8_t id, uint8_t* buf, uint32_t bufLen);
 #ifdef XCP_ENABLE_IDT_A2L_UPLOAD // Enable GET_ID: A2L content upload to host
@@ -5,7 +5,7 @@
 | Description:
 |   XCP on UDP Server
 |   SHows how to integrate the XCP driver in an application
-|   Creates threads for cmd handling and data transmission
+|   Creates threads for cmd handling and data transmission, or a single epoll event loop thread (XCPTL_ENABLE_EPOLL)
 |
 | Copyright (c) Vector Informatik GmbH. All rights reserved.
 | Licensed under the MIT license. See LICENSE file in the project root for details.
@@ -17,12 +17,16 @@
 #include "platform.h"
 #include "util.h"
 
+#include "xcptl_cfg.h"  // Transport layer configuration
 #include "xcpTl.h"
 #include "xcpLite.h"    // Protocol layer interface
 #include "xcpAppl.h"    // Dependecies to application code
 #include "xcpServer.h"
 
 
+#ifdef XCPTL_ENABLE_EPOLL
+static void* XcpServerEventLoopThread(void* par);
+#else
 #ifdef _WIN
 static DWORD WINAPI XcpServerReveiveThread(LPVOID lpParameter);
 #else
@@ -33,9 +37,29 @@ static DWORD WINAPI XcpServerTransmitThread(LPVOID lpParameter);
 #else
 static void* XcpServerTransmitThread(void* par);
 #endif
+#endif
+#ifdef XCP_ENABLE_TIMER_EVENTS
+#ifndef XCP_ENABLE_DAQ_EVENT_LIST
+#error "XCP_ENABLE_TIMER_EVENTS requires XCP_ENABLE_DAQ_EVENT_LIST!"
+#endif
+#ifdef _WIN
+static DWORD WINAPI XcpServerTimerThread(LPVOID lpParameter);
+#else
+static void* XcpServerTimerThread(void* par);
+#endif
+static const uint32_t gXcpTimerEventCycleMs[] = XCP_TIMER_EVENT_CYCLES_MS;
+#define XCP_TIMER_EVENT_COUNT (sizeof(gXcpTimerEventCycleMs)/sizeof(gXcpTimerEventCycleMs[0]))
+#endif
+#ifdef XCP_ENABLE_ASYNC_CMD
+#ifdef _WIN
+static DWORD WINAPI XcpServerWorkerThread(LPVOID lpParameter);
+#else
+static void* XcpServerWorkerThread(void* par);
+#endif
+#endif
 
 
-static struct {
+typedef struct {
 
     BOOL isInit; 
 
@@ -43,12 +67,29 @@ static struct {
     uint64_t FlushCycleTimer;
 
     // Threads
+    // With XCPTL_ENABLE_EPOLL, a single event loop thread receives and transmits, DAQThreadHandle==CMDThreadHandle
     tXcpThread DAQThreadHandle;
     volatile int TransmitThreadRunning;
     tXcpThread CMDThreadHandle;
     volatile int ReceiveThreadRunning;
+#ifdef XCP_ENABLE_TIMER_EVENTS
+    tXcpThread TimerThreadHandle;
+    volatile int TimerThreadRunning;
+    char TimerEventName[XCP_TIMER_EVENT_COUNT][16];
+    tXcpTimerEventStats TimerEvent[XCP_TIMER_EVENT_COUNT];
+#endif
+#ifdef XCP_ENABLE_ASYNC_CMD
+    tXcpThread WorkerThreadHandle;
+#endif
+
+} tXcpServerData;
 
-} gXcpServer;
+#if XCP_MAX_SERVERS > 1
+static tXcpServerData gXcpServers[XCP_MAX_SERVERS];
+#define gXcpServer (gXcpServers[gXcpSelectedServer])
+#else
+static tXcpServerData gXcpServer;
+#endif
 
 
 // Check XCP server status
@@ -79,24 +120,144 @@ BOOL XcpServerInit( const uint8_t *addr, uint16_t port, BOOL useTCP) {
     // Start XCP protocol layer
     XcpStart();
 
+#ifdef XCP_ENABLE_TIMER_EVENTS
+    // Create the server timer events, before the application creates its events
+    for (uint32_t i = 0; i < XCP_TIMER_EVENT_COUNT; i++) {
+        tXcpTimerEventStats* t = &gXcpServer.TimerEvent[i];
+        SNPRINTF(gXcpServer.TimerEventName[i], sizeof(gXcpServer.TimerEventName[i]), "timer_%ums", gXcpTimerEventCycleMs[i]);
+        t->name = gXcpServer.TimerEventName[i];
+        t->cycleMs = gXcpTimerEventCycleMs[i];
+        t->event = XcpCreateEvent(t->name, t->cycleMs * 1000000, 0, 0, 0);
+        t->count = t->missed = 0;
+        t->jitterMin = t->jitterMax = t->jitterSum = 0;
+    }
+#endif
+
     // Create threads
-    create_thread(&gXcpServer.DAQThreadHandle, XcpServerTransmitThread);
-    create_thread(&gXcpServer.CMDThreadHandle, XcpServerReveiveThread);
+#ifdef XCPTL_ENABLE_EPOLL
+    create_thread_arg(&gXcpServer.CMDThreadHandle, XcpServerEventLoopThread, (void*)(uintptr_t)XcpGetServer());
+    gXcpServer.DAQThreadHandle = gXcpServer.CMDThreadHandle;
+#else
+    create_thread_arg(&gXcpServer.DAQThreadHandle, XcpServerTransmitThread, (void*)(uintptr_t)XcpGetServer());
+    create_thread_arg(&gXcpServer.CMDThreadHandle, XcpServerReveiveThread, (void*)(uintptr_t)XcpGetServer());
+#endif
+#ifdef XCP_ENABLE_TIMER_EVENTS
+    create_thread_arg(&gXcpServer.TimerThreadHandle, XcpServerTimerThread, (void*)(uintptr_t)XcpGetServer());
+#endif
+#ifdef XCP_ENABLE_ASYNC_CMD
+    create_thread_arg(&gXcpServer.WorkerThreadHandle, XcpServerWorkerThread, (void*)(uintptr_t)XcpGetServer());
+#endif
     
     gXcpServer.isInit = TRUE;
     return TRUE;
 }
 
+// Start an additional server instance, the instance is selected for the calling thread only during initialization
+// The application selects it with XcpSelectServer to create and trigger its events
+BOOL XcpServerInitExt(uint8_t server, const uint8_t* addr, uint16_t port, BOOL useTCP) {
+
+    if (server >= XCP_MAX_SERVERS) return FALSE;
+    uint8_t prev = XcpGetServer();
+    XcpSelectServer(server);
+    BOOL ok = XcpServerInit(addr, port, useTCP);
+    XcpSelectServer(prev);
+    return ok;
+}
+
+BOOL XcpServerShutdownExt(uint8_t server) {
+
+    if (server >= XCP_MAX_SERVERS) return FALSE;
+    uint8_t prev = XcpGetServer();
+    XcpSelectServer(server);
+    BOOL ok = XcpServerShutdown();
+    XcpSelectServer(prev);
+    return ok;
+}
+
+BOOL XcpServerStatusExt(uint8_t server) {
+
+    if (server >= XCP_MAX_SERVERS) return FALSE;
+    uint8_t prev = XcpGetServer();
+    XcpSelectServer(server);
+    BOOL ok = XcpServerStatus();
+    XcpSelectServer(prev);
+    return ok;
+}
+
+// Set scheduling policy, priority and CPU affinity of XCP server threads
+BOOL XcpServerConfigureThreads(uint8_t threads, const tThreadConfig* config) {
+
+    BOOL ok = TRUE;
+
+    if (!gXcpServer.isInit) return FALSE;
+#ifdef XCPTL_ENABLE_EPOLL
+    if (threads & (XCP_SERVER_THREAD_TRANSMIT | XCP_SERVER_THREAD_RECEIVE | XCP_SERVER_THREAD_MULTICAST)) ok = threadConfigure(gXcpServer.CMDThreadHandle, config) && ok;
+#else
+    if (threads & XCP_SERVER_THREAD_TRANSMIT) ok = threadConfigure(gXcpServer.DAQThreadHandle, config) && ok;
+    if (threads & XCP_SERVER_THREAD_RECEIVE) ok = threadConfigure(gXcpServer.CMDThreadHandle, config) && ok;
+#endif
+#ifdef XCP_ENABLE_TIMER_EVENTS
+    if (threads & XCP_SERVER_THREAD_TIMER) ok = threadConfigure(gXcpServer.TimerThreadHandle, config) && ok;
+#endif
+#ifdef XCP_ENABLE_ASYNC_CMD
+    if (threads & XCP_SERVER_THREAD_WORKER) ok = threadConfigure(gXcpServer.WorkerThreadHandle, config) && ok;
+#endif
+#ifdef XCPTL_ENABLE_MULTICAST
+    if (threads & XCP_SERVER_THREAD_MULTICAST) ok = XcpTlConfigureMulticastThread(config) && ok;
+#endif
+    return ok;
+}
+
 BOOL XcpServerShutdown() {
     if (gXcpServer.isInit) {
         XcpDisconnect();
+#ifdef XCP_ENABLE_TIMER_EVENTS
+        cancel_thread(gXcpServer.TimerThreadHandle);
+        for (uint32_t i = 0; i < XCP_TIMER_EVENT_COUNT; i++) {
+            tXcpTimerEventStats* t = &gXcpServer.TimerEvent[i];
+            if (t->count > 0) DBG_PRINTF1("Timer event %s: count=%" PRIu64 ", missed=%" PRIu64 ", jitter min=%" PRIu64 "ns avg=%" PRIu64 "ns max=%" PRIu64 "ns\n", t->name, t->count, t->missed, t->jitterMin, t->jitterSum / t->count, t->jitterMax);
+        }
+#endif
+#ifdef XCP_ENABLE_ASYNC_CMD
+        cancel_thread(gXcpServer.WorkerThreadHandle);
+#endif
+#ifndef XCPTL_ENABLE_EPOLL
         cancel_thread(gXcpServer.DAQThreadHandle);
+#endif
         cancel_thread(gXcpServer.CMDThreadHandle);
         XcpTlShutdown();
     }
     return TRUE;
 }
 
+#ifdef XCP_ENABLE_TIMER_EVENTS
+// Get the server timer events and their jitter statistics
+const tXcpTimerEventStats* XcpServerGetTimerEvents(uint16_t* count) {
+    if (count != NULL) *count = (uint16_t)XCP_TIMER_EVENT_COUNT;
+    return gXcpServer.TimerEvent;
+}
+#endif
+
+
+#ifdef XCPTL_ENABLE_EPOLL
+
+// XCP server event loop thread
+// Receives commands and transmits responses and DAQ data in a single thread, the transport layer waits on all sockets and the transmit queue with epoll
+static void* XcpServerEventLoopThread(void* par)
+{
+    XcpSelectServer((uint8_t)(uintptr_t)par); // Thread runs in the context of its server instance
+    threadPrefaultStack();
+    XCP_DBG_PRINT3("Start XCP event loop thread\n");
+
+    gXcpServer.TransmitThreadRunning = gXcpServer.ReceiveThreadRunning = 1;
+    XcpTlEventLoop((uint32_t)(gXcpServer.FlushCycleNs / CLOCK_TICKS_PER_MS));
+    gXcpServer.TransmitThreadRunning = gXcpServer.ReceiveThreadRunning = 0;
+
+    XCP_DBG_PRINT_ERROR("ERROR: XcpServerEventLoopThread terminated!\n");
+    return 0;
+}
+
+#else
 
 // XCP server unicast command receive thread
 #ifdef _WIN
@@ -105,7 +266,8 @@ DWORD WINAPI XcpServerReveiveThread(LPVOID par)
 extern void* XcpServerReveiveThread(void* par)
 #endif
 {
-    (void)par;
+    XcpSelectServer((uint8_t)(uintptr_t)par);
+    threadPrefaultStack();
     XCP_DBG_PRINT3("Start XCP CMD thread\n");
 
     // Receive XCP unicast commands loop
@@ -128,7 +290,8 @@ DWORD WINAPI XcpServerTransmitThread(LPVOID par)
 extern void* XcpServerTransmitThread(void* par)
 #endif
 {
-    (void)par;
+    XcpSelectServer((uint8_t)(uintptr_t)par);
+    threadPrefaultStack();
     XCP_DBG_PRINT3("Start XCP DAQ thread\n");
 
     // Transmit loop
@@ -159,4 +322,80 @@ extern void* XcpServerTransmitThread(void* par)
     return 0;
 }
 
+#endif // !XCPTL_ENABLE_EPOLL
+
+
+#ifdef XCP_ENABLE_TIMER_EVENTS
+
+// XCP server timer thread
+// Triggers the server timer events, DAQ lists associated to these events sample global variables
+#ifdef _WIN
+DWORD WINAPI XcpServerTimerThread(LPVOID par)
+#else
+extern void* XcpServerTimerThread(void* par)
+#endif
+{
+    uint64_t next[XCP_TIMER_EVENT_COUNT];
+    uint64_t t, n, j;
+    uint32_t i;
+
+    XcpSelectServer((uint8_t)(uintptr_t)par);
+    threadPrefaultStack();
+    XCP_DBG_PRINT3("Start XCP timer thread\n");
+
+    gXcpServer.TimerThreadRunning = 1;
+    t = clockGetMonotonicNs();
+    for (i = 0; i < XCP_TIMER_EVENT_COUNT; i++) next[i] = t + gXcpServer.TimerEvent[i].cycleMs * 1000000ULL;
+    for (;;) {
+
+        // Sleep until the next timer event is due
+        n = next[0];
+        for (i = 1; i < XCP_TIMER_EVENT_COUNT; i++) if (next[i] < n) n = next[i];
+        sleepUntilNs(n);
+        t = clockGetMonotonicNs();
+
+        // Trigger all due timer events, update the jitter statistics
+        for (i = 0; i < XCP_TIMER_EVENT_COUNT; i++) {
+            tXcpTimerEventStats* e = &gXcpServer.TimerEvent[i];
+            if (next[i] > t) continue;
+            XcpEvent(e->event);
+            j = t - next[i];
+            if (e->count == 0 || j < e->jitterMin) e->jitterMin = j;
+            if (j > e->jitterMax) e->jitterMax = j;
+            e->jitterSum += j;
+            e->count++;
+            next[i] += e->cycleMs * 1000000ULL;
+            while (next[i] <= t) { // Skip missed cycles
+                next[i] += e->cycleMs * 1000000ULL;
+                e->missed++;
+            }
+        }
+    }
+    gXcpServer.TimerThreadRunning = 0;
+    return 0;
+}
+
+#endif
+
+
+#ifdef XCP_ENABLE_ASYNC_CMD
 
+// XCP server worker thread
+// Executes commands which are deferred to the worker context, without blocking the command receive thread
+#ifdef _WIN
+DWORD WINAPI XcpServerWorkerThread(LPVOID par)
+#else
+extern void* XcpServerWorkerThread(void* par)
+#endif
+{
+    XcpSelectServer((uint8_t)(uintptr_t)par);
+    threadPrefaultStack();
+    XCP_DBG_PRINT3("Start XCP worker thread\n");
+
+    for (;;) {
+        if (!XcpWorker()) sleepMs(2);
+    }
+    return 0;
+}
+
+#endif
@@ -8,3 +8,34 @@ extern BOOL XcpServerInit(const uint8_t *addr, uint16_t port, BOOL useTCP);
 extern BOOL XcpServerShutdown();
 extern BOOL XcpServerStatus();
 
+// Independent server instances (XCP_MAX_SERVERS > 1), with own protocol and transport layer state, transmit queue and threads
+// XcpServerInit, XcpServerShutdown, XcpServerStatus and all protocol layer functions (XcpCreateEvent, XcpEvent, ...) use the server selected with XcpSelectServer, default is 0
+// Commands of all servers are executed mutually exclusive, because calibration segments, memory regions and ApplXcp callbacks are shared
+extern BOOL XcpServerInitExt(uint8_t server, const uint8_t* addr, uint16_t port, BOOL useTCP);
+extern BOOL XcpServerShutdownExt(uint8_t server);
+extern BOOL XcpServerStatusExt(uint8_t server);
+
+// Set scheduling policy, priority and CPU affinity of the XCP server threads
+#define XCP_SERVER_THREAD_TRANSMIT  0x01
+#define XCP_SERVER_THREAD_RECEIVE   0x02
+#define XCP_SERVER_THREAD_TIMER     0x04
+#define XCP_SERVER_THREAD_MULTICAST 0x08
+#define XCP_SERVER_THREAD_WORKER    0x10
+#define XCP_SERVER_THREAD_ALL       0x1F
+extern BOOL XcpServerConfigureThreads(uint8_t threads, const tThreadConfig* config);
+
+#ifdef XCP_ENABLE_TIMER_EVENTS
+// Server timer event and its jitter statistics
+typedef struct {
+    const char* name;
+    uint16_t event;               // XCP event number
+    uint32_t cycleMs;
+    uint64_t count;               // Number of cycles
+    uint64_t missed;              // Number of skipped cycles
+    uint64_t jitterMin;           // Wakeup latency in ns
+    uint64_t jitterMax;
+    uint64_t jitterSum;
+} tXcpTimerEventStats;
+extern const tXcpTimerEventStats* XcpServerGetTimerEvents(uint16_t* count);
+#endif
+
@@ -33,6 +33,14 @@
 #if ((XCPTL_MAX_DTO_SIZE&0x03) != 0)
 #error "XCPTL_MAX_DTO_SIZE should be aligned to 4!"
 #endif
+#ifdef XCPTL_ENABLE_EPOLL
+#ifndef _LINUX
+#error "XCPTL_ENABLE_EPOLL is only supported on Linux!"
+#endif
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
 
 
 
@@ -49,10 +57,17 @@ typedef struct {
     uint8_t packet[1];  // message data
 } tXcpMessage;
 
+// STIM DTOs are received in the command message buffer
+#if defined(XCP_ENABLE_DAQ_STIM) && (XCPTL_MAX_DTO_SIZE > XCPTL_MAX_CTO_SIZE)
+#define XCPTL_MAX_RX_SIZE XCPTL_MAX_DTO_SIZE
+#else
+#define XCPTL_MAX_RX_SIZE XCPTL_MAX_CTO_SIZE
+#endif
+
 typedef struct {
     uint16_t dlc;
     uint16_t ctr;
-    uint8_t packet[XCPTL_MAX_CTO_SIZE];
+    uint8_t packet[XCPTL_MAX_RX_SIZE];
 } tXcpCtoMessage;
 
 
@@ -67,7 +82,7 @@ typedef struct {
 } tXcpMessageBuffer;
 
 
-static struct {
+typedef struct {
 
     SOCKET Sock;
 #ifdef XCPTL_ENABLE_TCP
@@ -105,9 +120,25 @@ static struct {
     SOCKET MulticastSock;
 #endif
 
+    // Single threaded event loop
+#ifdef XCPTL_ENABLE_EPOLL
+    int Epoll;
+    int TransmitEvent; // eventfd, signaled when complete segments are in the transmit queue
+    int FlushTimer; // timerfd, flush cycle
+    volatile BOOL TransmitSignaled; // TransmitEvent has been signaled and not yet handled
+    pthread_t EventLoopThread;
+#endif
+
     MUTEX Mutex_Queue;
     
-} gXcpTl;
+} tXcpTlData;
+
+#if XCP_MAX_SERVERS > 1
+static tXcpTlData gXcpTlServers[XCP_MAX_SERVERS]; // Transport layer of each server instance
+#define gXcpTl (gXcpTlServers[gXcpSelectedServer])
+#else
+static tXcpTlData gXcpTl;
+#endif
 
 #if defined XCPTL_ENABLE_TCP && defined XCPTL_ENABLE_UDP
 #define isTCP() (gXcpTl.ListenSock != INVALID_SOCKET)
@@ -213,6 +244,18 @@ static void getSegmentBuffer() {
     }
 }
 
+#ifdef XCPTL_ENABLE_EPOLL
+// Wake up the event loop, if there are complete segments in the transmit queue
+// Signaled once until the event loop has handled it, to avoid a syscall for each committed DTO
+static void signalTransmitData() {
+    if (gXcpTl.queue_len > 1 && !gXcpTl.TransmitSignaled) {
+        uint64_t one = 1;
+        gXcpTl.TransmitSignaled = TRUE;
+        if (write(gXcpTl.TransmitEvent, &one, sizeof(one)) != sizeof(one)) {} // Counter overflow is not possible
+    }
+}
+#endif
+
 // Clear and init transmit queue
 void XcpTlInitTransmitQueue() {
 
@@ -331,6 +374,9 @@ void XcpTlCommitTransmitBuffer(void *handle) {
           SetEvent(gXcpTl.queue_event);
         }
 #endif
+#ifdef XCPTL_ENABLE_EPOLL
+        signalTransmitData();
+#endif
 
     }
 }
@@ -341,11 +387,24 @@ void XcpTlFlushTransmitBuffer() {
         getSegmentBuffer();
     }
     mutexUnlock(&gXcpTl.Mutex_Queue);
+#ifdef XCPTL_ENABLE_EPOLL
+    signalTransmitData();
+#endif
 }
 
 void XcpTlWaitForTransmitQueue() {
 
     XcpTlFlushTransmitBuffer();
+#ifdef XCPTL_ENABLE_EPOLL
+    // Called by a command in the event loop thread, there is no other thread to empty the queue
+    if (pthread_equal(pthread_self(), gXcpTl.EventLoopThread)) {
+        while (gXcpTl.queue_len > 1) {
+            if (!XcpTlHandleTransmitQueue()) return;
+            if (gXcpTl.queue_len > 1) sleepMs(2); // Would block
+        }
+        return;
+    }
+#endif
     do {
         sleepMs(2);
     } while (gXcpTl.queue_len > 1) ;
@@ -516,6 +575,9 @@ BOOL XcpTlHandleCommands() {
             else {
                 XCP_DBG_PRINTF1("Master %u.%u.%u.%u accepted!\n", gXcpTl.MasterAddr[0], gXcpTl.MasterAddr[1], gXcpTl.MasterAddr[2], gXcpTl.MasterAddr[3]);
                 XCP_DBG_PRINT3("Listening for XCP commands\n");
+#ifdef XCPTL_ENABLE_EPOLL
+                return TRUE; // Don't block in recv, the event loop registers the new socket
+#endif
             }
         }
 
@@ -592,7 +654,8 @@ extern void* XcpTlMulticastThread(void* par)
 {
     uint8_t buffer[256];
     int16_t n;
-    (void)par;
+    XcpSelectServer((uint8_t)(uintptr_t)par);
+    threadPrefaultStack();
     for (;;) {
         n = socketRecvFrom(gXcpTl.MulticastSock, buffer, (uint16_t)sizeof(buffer), NULL, NULL);
         if (n <= 0) break; // Terminate on error or socket close 
@@ -627,6 +690,7 @@ int XcpTlInit(const uint8_t* addr, uint16_t port, BOOL useTCP) {
     gXcpTl.Sock = INVALID_SOCKET;
 
     mutexInit(&gXcpTl.Mutex_Queue, 0, 1000);
+    memset(gXcpTl.queue, 0, sizeof(gXcpTl.queue)); // Prefault the transmit queue memory
     XcpTlInitTransmitQueue();
 #ifdef _WIN
     gXcpTl.queue_event = CreateEvent(NULL, TRUE /* manual reset */, FALSE /* initial state */, NULL);
@@ -668,19 +732,50 @@ int XcpTlInit(const uint8_t* addr, uint16_t port, BOOL useTCP) {
     if (!socketJoin(gXcpTl.MulticastSock, maddr)) return FALSE;
     XCP_DBG_PRINTF2("  Listening for XCP multicast on %u.%u.%u.%u\n", maddr[0], maddr[1], maddr[2], maddr[3]);
 
+#ifndef XCPTL_ENABLE_EPOLL // Handled in the event loop
     XCP_DBG_PRINT3("  Start XCP multicast thread\n");
-    create_thread(&gXcpTl.MulticastThreadHandle, XcpTlMulticastThread);
+    create_thread_arg(&gXcpTl.MulticastThreadHandle, XcpTlMulticastThread, (void*)(uintptr_t)XcpGetServer());
+#endif
+#endif
+
+#ifdef XCPTL_ENABLE_EPOLL
+    gXcpTl.TransmitSignaled = FALSE;
+    gXcpTl.Epoll = epoll_create1(0);
+    gXcpTl.TransmitEvent = eventfd(0, EFD_NONBLOCK);
+    gXcpTl.FlushTimer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (gXcpTl.Epoll < 0 || gXcpTl.TransmitEvent < 0 || gXcpTl.FlushTimer < 0) {
+        XCP_DBG_PRINTF_ERROR("ERROR %u: epoll init failed!\n", errno);
+        return FALSE;
+    }
 #endif
     return TRUE;
 }
 
 
+#ifdef XCPTL_ENABLE_MULTICAST
+BOOL XcpTlConfigureMulticastThread(const tThreadConfig* config) {
+#ifdef XCPTL_ENABLE_EPOLL
+    (void)config;
+    return TRUE; // No multicast thread, multicast is received in the event loop thread
+#else
+    return threadConfigure(gXcpTl.MulticastThreadHandle, config);
+#endif
+}
+#endif
+
 void XcpTlShutdown() {
 
 #ifdef XCPTL_ENABLE_MULTICAST
     socketClose(&gXcpTl.MulticastSock);
+#ifndef XCPTL_ENABLE_EPOLL
     sleepMs(200);
     cancel_thread(gXcpTl.MulticastThreadHandle);
+#endif
+#endif
+#ifdef XCPTL_ENABLE_EPOLL
+    close(gXcpTl.FlushTimer);
+    close(gXcpTl.TransmitEvent);
+    close(gXcpTl.Epoll);
 #endif
     mutexDestroy(&gXcpTl.Mutex_Queue);
 #ifdef XCPTL_ENABLE_TCP
@@ -713,6 +808,106 @@ void XcpTlWaitForTransmitData(uint32_t timeout_ms) {
 
 
 
+#ifdef XCPTL_ENABLE_EPOLL
+
+static BOOL epollAdd(int fd) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(gXcpTl.Epoll, EPOLL_CTL_ADD, fd, &ev) == 0) return TRUE;
+    XCP_DBG_PRINTF_ERROR("ERROR %u: epoll_ctl failed!\n", errno);
+    return FALSE;
+}
+
+// Single threaded transport layer, runs until an error occurs
+// Multiplexes the TCP listen socket, the unicast and multicast command sockets, the transmit queue event and the flush cycle timer
+BOOL XcpTlEventLoop(uint32_t flushCycleMs) {
+
+    struct epoll_event events[8];
+    struct itimerspec t;
+    uint64_t u;
+    int i, n;
+
+    gXcpTl.EventLoopThread = pthread_self();
+    if (!epollAdd(gXcpTl.TransmitEvent) || !epollAdd(gXcpTl.FlushTimer)) return FALSE;
+#ifdef XCPTL_ENABLE_TCP
+    if (isTCP()) {
+        if (!epollAdd(gXcpTl.ListenSock)) return FALSE;
+    }
+    else
+#endif
+    {
+        if (!epollAdd(gXcpTl.Sock)) return FALSE;
+    }
+#ifdef XCPTL_ENABLE_MULTICAST
+    if (!epollAdd(gXcpTl.MulticastSock)) return FALSE;
+#endif
+    if (flushCycleMs > 0) {
+        t.it_interval.tv_sec = flushCycleMs / 1000;
+        t.it_interval.tv_nsec = (long)(flushCycleMs % 1000) * 1000000;
+        t.it_value = t.it_interval;
+        timerfd_settime(gXcpTl.FlushTimer, 0, &t, NULL);
+    }
+
+    for (;;) {
+        n = epoll_wait(gXcpTl.Epoll, events, (int)(sizeof(events) / sizeof(events[0])), -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            XCP_DBG_PRINTF_ERROR("ERROR %u: epoll_wait failed!\n", errno);
+            return FALSE;
+        }
+        for (i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+
+            // Transmit all complete segments
+            if (fd == gXcpTl.TransmitEvent) {
+                if (read(fd, &u, sizeof(u)) != sizeof(u)) {} // Reset the eventfd counter
+                gXcpTl.TransmitSignaled = FALSE; // Reset before the queue is checked, a commit after this point signals again
+                if (!XcpTlHandleTransmitQueue()) return FALSE;
+            }
+
+            // Flush cycle, keep tool visualizations up to date
+            else if (fd == gXcpTl.FlushTimer) {
+                if (read(fd, &u, sizeof(u)) != sizeof(u)) {} // Reset the timerfd expiration count
+                XcpTlFlushTransmitQueue();
+            }
+
+#ifdef XCPTL_ENABLE_MULTICAST
+            else if (fd == gXcpTl.MulticastSock) {
+                uint8_t buffer[256];
+                int16_t m = socketRecvFrom(gXcpTl.MulticastSock, buffer, (uint16_t)sizeof(buffer), NULL, NULL);
+                if (m > 0) handleXcpMulticast(m, (tXcpCtoMessage*)buffer);
+            }
+#endif
+
+#ifdef XCPTL_ENABLE_TCP
+            // Accept a TCP connection, only one connection at a time, the listen socket is not polled while connected
+            else if (isTCP() && fd == gXcpTl.ListenSock) {
+                if (gXcpTl.Sock != INVALID_SOCKET) continue;
+                XcpTlHandleCommands();
+                if (gXcpTl.Sock != INVALID_SOCKET) {
+                    epoll_ctl(gXcpTl.Epoll, EPOLL_CTL_DEL, gXcpTl.ListenSock, NULL);
+                    if (!epollAdd(gXcpTl.Sock)) return FALSE;
+                }
+            }
+#endif
+
+            // Handle a XCP command
+            else if (fd == gXcpTl.Sock) {
+                if (!XcpTlHandleCommands()) return FALSE;
+#ifdef XCPTL_ENABLE_TCP
+                if (isTCP() && gXcpTl.Sock == INVALID_SOCKET) { // Closed by the master, a closed socket is removed from the epoll set
+                    if (!epollAdd(gXcpTl.ListenSock)) return FALSE;
+                }
+#endif
+            }
+        }
+    }
+}
+
+#endif
+
+
 //-------------------------------------------------------------------------------------------------------
 
 int32_t XcpTlGetLastError() {
@@ -19,4 +19,8 @@ extern BOOL XcpTlHandleTransmitQueue(); // Send all full packets in the transmit
 extern void XcpTlInitTransmitQueue(); // Initialize the transmit queue
 extern void XcpTlWaitForTransmitData(uint32_t timeout_ms); // Wait until packets are ready to send
 extern void XcpTlSetClusterId(uint16_t clusterId); // Set cluster id for GET_DAQ_CLOCK_MULTICAST reception
+extern BOOL XcpTlConfigureMulticastThread(const tThreadConfig* config); // Set scheduling and affinity of the multicast thread (XCPTL_ENABLE_MULTICAST)
+#ifdef XCPTL_ENABLE_EPOLL
+extern BOOL XcpTlEventLoop(uint32_t flushCycleMs); // Single threaded command receive and transmit loop, returns on error
+#endif
 